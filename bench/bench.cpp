@@ -0,0 +1,395 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "../include/hyper.h"
+#include "../include/engine.h"
+#include "../include/morton.h"
+#include "../include/tiled.h"
+#include "../examples/examples.h"
+
+/*
+ * Benchmarks of the space traversal, neighbor access, layouts and engines over a range of
+ * dimensions, radii and sizes. Human-readable results go to stderr, JSON to stdout or --out.
+ *
+ * $ cmake -S . -B build && cmake --build build --target bench && build/bench --out bench.json
+ * $ g++ -std=c++17 -O2 -DNDEBUG -pthread -o bench bench/bench.cpp
+ *
+ * Options: --min-time <seconds> per benchmark (default 0.2), --filter <substring> of the
+ * benchmark's name, layout or extents, --out <path> of the JSON file.
+ *
+ * */
+
+namespace sprogar
+{
+namespace bench
+{
+	using namespace sprogar::hyper;
+
+	struct options
+	{
+		double min_time = 0.2;
+		std::string filter;
+		std::string out;
+	};
+
+	struct result
+	{
+		std::string name, layout;
+		std::vector<unsigned> extents; // outermost first
+		unsigned radius;
+		bool wrap;
+		position_t cells; // per repetition
+		std::uint64_t neighbors; // per repetition, 0 where not applicable
+		std::uint64_t repetitions;
+		double seconds;
+	};
+
+	// keeps the compiler from discarding the measured work
+	inline void keep(std::uint64_t value)
+	{
+		static volatile std::uint64_t sink;
+		sink = sink + value;
+	}
+	// keeps the compiler from folding a loop that produces the value, e.g. into a closed form
+	template <typename T>
+	inline void opaque(T& value)
+	{
+#if defined(__GNUC__)
+		asm volatile("" : "+r"(value));
+#else
+		keep((std::uint64_t)value);
+#endif
+	}
+
+	// runs body() a doubling number of times until the runs take min_time; returns the repetitions and seconds
+	template <class Body>
+	std::pair<std::uint64_t, double> measure(double min_time, Body body)
+	{
+		typedef std::chrono::steady_clock clock;
+		body(); // warm-up
+		for (std::uint64_t repetitions = 1;; repetitions *= 2) {
+			const auto start = clock::now();
+			for (std::uint64_t r = 0; r < repetitions; ++r)
+				body();
+			const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+			if (seconds >= min_time or repetitions >= (std::uint64_t(1) << 40))
+				return { repetitions, seconds };
+		}
+	}
+
+	class suite
+	{
+		const options opt;
+		std::vector<result> results;
+
+		static std::string extents_string(const std::vector<unsigned>& extents)
+		{
+			std::ostringstream os;
+			for (std::size_t d = 0; d < extents.size(); ++d)
+				os << (d ? "x" : "") << extents[d];
+			return os.str();
+		}
+		template <bool wrap, unsigned R, unsigned... XX>
+		static std::string id(const std::string& name, const std::string& layout)
+		{
+			return name + " " + layout + " " + extents_string({ XX... }) + " R" + std::to_string(R) + (wrap ? " wrapped" : " unwrapped");
+		}
+
+	public:
+		explicit suite(options o)
+			: opt(std::move(o))
+		{
+		}
+
+		// whether the benchmark passes the filter
+		template <bool wrap, unsigned R, unsigned... XX>
+		bool selects(const std::string& name, const std::string& layout) const
+		{
+			return id<wrap, R, XX...>(name, layout).find(opt.filter) != std::string::npos;
+		}
+
+		// measures body(), which processes the cells of the space 'passes' times, unless it is filtered out
+		template <bool wrap, unsigned R, unsigned... XX, class Body>
+		void run(const std::string& name, const std::string& layout, std::uint64_t neighbors, Body body, unsigned passes = 1)
+		{
+			if (not selects<wrap, R, XX...>(name, layout))
+				return;
+			result r{ name, layout, { XX... }, R, wrap, passes * (position_t(1) * ... * XX), passes * neighbors, 0, 0.0 };
+			const std::string id = suite::id<wrap, R, XX...>(name, layout);
+
+			std::tie(r.repetitions, r.seconds) = measure(opt.min_time, body);
+			const double per_cell = r.seconds * 1e9 / ((double)r.cells * r.repetitions);
+			std::clog << id << ": " << (double)r.cells * r.repetitions / r.seconds << " cells/s, " << per_cell << " ns/cell";
+			if (r.neighbors > 0)
+				std::clog << ", " << r.seconds * 1e9 / ((double)r.neighbors * r.repetitions) << " ns/neighbor";
+			std::clog << '\n';
+			results.push_back(r);
+		}
+
+		void write_json(std::ostream& os) const
+		{
+			os << "{\n  \"library\": \"hyperspace\",\n  \"threads\": " << std::thread::hardware_concurrency()
+				<< ",\n  \"min_time\": " << opt.min_time << ",\n  \"results\": [";
+			for (std::size_t i = 0; i < results.size(); ++i) {
+				const result& r = results[i];
+				os << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"layout\": \"" << r.layout
+					<< "\", \"dimensions\": " << r.extents.size() << ", \"extents\": [";
+				for (std::size_t d = 0; d < r.extents.size(); ++d)
+					os << (d ? ", " : "") << r.extents[d];
+				os << "], \"radius\": " << r.radius << ", \"wrap\": " << (r.wrap ? "true" : "false")
+					<< ", \"cells\": " << r.cells << ", \"neighbors\": " << r.neighbors
+					<< ", \"repetitions\": " << r.repetitions << ", \"seconds\": " << r.seconds
+					<< ", \"cells_per_sec\": " << (double)r.cells * r.repetitions / r.seconds
+					<< ", \"ns_per_neighbor\": ";
+				if (r.neighbors > 0)
+					os << r.seconds * 1e9 / ((double)r.neighbors * r.repetitions);
+				else
+					os << "null";
+				os << '}';
+			}
+			os << "\n  ]\n}\n";
+		}
+	};
+
+	// the sum of the neighbors of all cells, a sweep that only measures the neighbor access of the layout
+	template <class Grid>
+	std::uint64_t neighbor_sum(const Grid& g)
+	{
+		std::uint64_t sum = 0;
+		for (auto it = g.begin(); it != g.end(); ++it)
+			sum += it.neighbors().sum();
+		return sum;
+	}
+
+	// the coordinates of the grid's cells, outermost first, in storage order
+	template <class Grid>
+	auto coordinates_of(const Grid& g)
+	{
+		constexpr unsigned D = Grid::dimension();
+		std::vector<std::array<unsigned, D>> coordinates;
+		coordinates.reserve(Grid::size());
+		for (auto it = g.begin(); it != g.end(); ++it) {
+			std::array<unsigned, D> c;
+			for (unsigned d = 0; d < D; ++d)
+				c[d] = it.coordinate(D - 1 - d);
+			coordinates.push_back(c);
+		}
+		return coordinates;
+	}
+
+	// The benchmarks of one space. Their fixtures take several times the memory of the space, so
+	// each is only built for benchmarks that pass the filter, and released when they are done.
+	template <bool wrap, unsigned R, unsigned... XX>
+	void sweep(suite& s)
+	{
+		constexpr unsigned D = sizeof...(XX);
+		constexpr unsigned B = D >= 3 ? 4 : 8;
+		typedef iterable_offsets<wrap, R, XX...> space;
+		typedef grid<int, R, wrap, XX...> cells;
+
+		const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+		const std::string all_threads = std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+		const std::string tiled = "tiled" + std::to_string(B);
+		auto selects = [&s](const std::string& name, std::initializer_list<std::string> layouts) {
+			for (const std::string& layout : layouts)
+				if (s.selects<wrap, R, XX...>(name, layout))
+					return true;
+			return false;
+		};
+		const bool traversal = selects("location_iterator::operator++", { "-" }) or selects("location_iterator::type", { "-" })
+			or selects("neighbors_offsets", { "-" });
+		const bool access = selects("operator()(cc...)", { "row-major" }) or selects("at(cc...)", { "row-major" });
+		const bool layouts = selects("neighbor sum", { "row-major", "morton", tiled });
+		const bool example = selects("game_of_life_iteration", { "row-major" });
+		const bool serial = selects("stencil_engine::step", { "1 thread" });
+		const bool parallel = selects("stencil_engine::step", { all_threads }) or selects("stencil_engine::step_blocked(k=4)", { all_threads });
+		if (not (traversal or access or layouts or example or serial or parallel))
+			return;
+
+		std::uint64_t neighbors = 0;
+		for (auto loc = space::begin(); loc != space::end(); ++loc)
+			neighbors += space::neighbors_offsets(loc.type()).size();
+
+		s.run<wrap, R, XX...>("location_iterator::operator++", "-", 0, [] {
+			std::uint64_t sum = 0;
+			for (auto loc = space::begin(); loc != space::end(); ++loc) {
+				position_t pos = loc;
+				opaque(pos);
+				sum += pos;
+			}
+			keep(sum);
+		});
+		s.run<wrap, R, XX...>("location_iterator::type", "-", 0, [] {
+			std::uint64_t sum = 0;
+			for (auto loc = space::begin(); loc != space::end(); ++loc) {
+				unsigned type = loc.type();
+				opaque(type);
+				sum += type;
+			}
+			keep(sum);
+		});
+		s.run<wrap, R, XX...>("neighbors_offsets", "-", neighbors, [] {
+			std::uint64_t sum = 0;
+			for (auto loc = space::begin(); loc != space::end(); ++loc)
+				for (offset_t off : space::neighbors_offsets(loc.type()))
+					sum += off;
+			keep(sum);
+		});
+
+		if (example) { // a whole step of the example
+			grid<bool, R, wrap, XX...> life, old;
+			for (position_t pos = 0; pos < cells::size(); ++pos)
+				life[pos] = pos * 2654435761u % 7 < 2;
+			s.run<wrap, R, XX...>("game_of_life_iteration", "row-major", neighbors, [&] {
+				examples::game_of_life_iteration(life, old, [](int count, bool alive) { return count == 3 or (alive and count == 2); });
+			});
+		}
+		if (not (access or layouts or serial or parallel))
+			return;
+
+		cells g;
+		for (position_t pos = 0; pos < cells::size(); ++pos)
+			g[pos] = (int)(pos * 7 % 13);
+
+		if (access) {
+			const auto coordinates = coordinates_of(g);
+			s.run<wrap, R, XX...>("operator()(cc...)", "row-major", 0, [&] {
+				std::uint64_t sum = 0;
+				for (const auto& c : coordinates)
+					sum += std::apply([&](auto... cc) { return g(cc...); }, c);
+				keep(sum);
+			});
+			s.run<wrap, R, XX...>("at(cc...)", "row-major", 0, [&] {
+				std::uint64_t sum = 0;
+				for (const auto& c : coordinates)
+					sum += *std::apply([&](auto... cc) { return g.at(cc...); }, c);
+				keep(sum);
+			});
+		}
+
+		// the same sweep over the layouts
+		s.run<wrap, R, XX...>("neighbor sum", "row-major", neighbors, [&] { keep(neighbor_sum(g)); });
+		auto copy = [&g](auto& layout) {
+			for (auto it = g.begin(); it != g.end(); ++it) {
+				std::array<unsigned, D> c;
+				for (unsigned d = 0; d < D; ++d)
+					c[d] = it.coordinate(D - 1 - d);
+				std::apply([&](auto... cc) { layout(cc...) = *it; }, c);
+			}
+		};
+		if (selects("neighbor sum", { "morton" })) {
+			morton_grid<int, R, wrap, XX...> morton;
+			copy(morton);
+			s.run<wrap, R, XX...>("neighbor sum", "morton", neighbors, [&] { keep(neighbor_sum(morton)); });
+		}
+		if (selects("neighbor sum", { tiled })) {
+			tiled_grid<int, B, R, wrap, XX...> bricks;
+			copy(bricks);
+			s.run<wrap, R, XX...>("neighbor sum", tiled, neighbors, [&] { keep(neighbor_sum(bricks)); });
+		}
+
+		// a whole step of the engines
+		auto rule = [](int cell, const auto& neighbors) { return (cell + neighbors.sum()) % 13; };
+		if (serial) {
+			stencil_engine<cells> engine(g, 1);
+			s.run<wrap, R, XX...>("stencil_engine::step", "1 thread", neighbors, [&] { engine.step(1, rule); });
+		}
+		if (parallel) {
+			stencil_engine<cells> engine(g, threads);
+			if (threads > 1) // else measured above
+				s.run<wrap, R, XX...>("stencil_engine::step", all_threads, neighbors, [&] { engine.step(1, rule); });
+			s.run<wrap, R, XX...>("stencil_engine::step_blocked(k=4)", all_threads, neighbors, [&] { engine.step_blocked(4, 4, rule); }, 4);
+		}
+	}
+
+	// both the wrapped and the unwrapped space
+	template <unsigned R, unsigned... XX>
+	void sweep_spaces(suite& s)
+	{
+		sweep<true, R, XX...>(s);
+		sweep<false, R, XX...>(s);
+	}
+
+} // namespace bench
+} // namespace sprogar
+
+int main(int argc, char* argv[])
+{
+	using namespace sprogar::bench;
+
+	options opt;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--min-time" and i + 1 < argc)
+			opt.min_time = std::atof(argv[++i]);
+		else if (arg == "--filter" and i + 1 < argc)
+			opt.filter = argv[++i];
+		else if (arg == "--out" and i + 1 < argc)
+			opt.out = argv[++i];
+		else {
+			std::cerr << "usage: " << argv[0] << " [--min-time seconds] [--filter substring] [--out file.json]\n";
+			return 2;
+		}
+	}
+
+	suite s(opt);
+	// D = 1..4, R = 1..2, a cache-resident size and a memory-bound one of 2^24 cells (64 MB of ints,
+	// beyond the last-level caches) each
+	sweep_spaces<1, 4096>(s);
+	sweep_spaces<1, 1 << 24>(s);
+	sweep_spaces<2, 4096>(s);
+	sweep_spaces<2, 1 << 24>(s);
+	sweep_spaces<1, 64, 64>(s);
+	sweep_spaces<1, 4096, 4096>(s);
+	sweep_spaces<2, 64, 64>(s);
+	sweep_spaces<2, 4096, 4096>(s);
+	sweep_spaces<1, 16, 16, 16>(s);
+	sweep_spaces<1, 256, 256, 256>(s);
+	sweep_spaces<2, 16, 16, 16>(s);
+	sweep_spaces<2, 256, 256, 256>(s);
+	sweep_spaces<1, 8, 8, 8, 8>(s);
+	sweep_spaces<1, 64, 64, 64, 64>(s);
+
+	if (opt.out.empty())
+		s.write_json(std::cout);
+	else {
+		std::ofstream file(opt.out);
+		s.write_json(file);
+		if (not file) {
+			std::cerr << "cannot write " << opt.out << '\n';
+			return 1;
+		}
+	}
+}
@@ -20,10 +20,30 @@
  *
  * */
 
+#include <utility>
+
 namespace sprogar
 {
 namespace examples
 {
+// central state-transition logic, usable for grids of all dimensions
+template <class AnyGrid>
+void game_of_life_iteration(AnyGrid& g, AnyGrid& old, bool (*rule)(int, bool))
+{
+    std::swap(g, old);
+
+    // for each cell in the grid
+    for(auto it = old.begin(); it != old.end(); ++it) {
+        int living_neighbors = 0;
+        for(auto off : it)
+            living_neighbors += it[off]; // bool -> 0 | 1
+
+        // exercise the CA rule to determine the new state
+        bool is_alive = it[0]; // or *it
+        g[it] = rule(living_neighbors, is_alive);
+    }
+}
+
 void game_of_life_2D();
 void game_of_life_3D();
 }  // namespace examples
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_ALLOCATOR_H_
+#define _SPROGAR_HYPERSPACE_ALLOCATOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		constexpr std::size_t cache_line = 64;
+		constexpr std::size_t huge_page = std::size_t(1) << 21;
+
+		namespace detail
+		{
+			// alignment of an allocation: huge allocations start at a huge page, so the OS can back them by huge pages
+			inline std::size_t allocation_alignment(std::size_t bytes, std::size_t alignment)
+			{
+				return bytes >= huge_page ? std::max(alignment, huge_page) : alignment;
+			}
+
+			inline void* allocate_aligned(std::size_t bytes, std::size_t alignment)
+			{
+				const std::size_t align = allocation_alignment(bytes, alignment);
+				void* p = ::operator new(bytes, std::align_val_t(align));
+#ifdef MADV_HUGEPAGE
+				if (align == huge_page)
+					::madvise(p, (bytes + huge_page - 1) / huge_page * huge_page, MADV_HUGEPAGE);
+#endif
+				return p;
+			}
+			inline void deallocate_aligned(void* p, std::size_t bytes, std::size_t alignment)
+			{
+				::operator delete(p, std::align_val_t(allocation_alignment(bytes, alignment)));
+			}
+		} // namespace detail
+
+		// Allocates cells at the given alignment (a cache line by default), and allocations of 2 MiB
+		// or more at huge page boundaries, advising the OS to back them by huge pages.
+		template <typename T, std::size_t Alignment = cache_line>
+		struct aligned_allocator
+		{
+			static_assert(Alignment >= alignof(T) and (Alignment & (Alignment - 1)) == 0, "invalid alignment");
+
+			typedef T value_type;
+			template <typename U>
+			struct rebind { typedef aligned_allocator<U, Alignment> other; };
+
+			aligned_allocator() noexcept {}
+			template <typename U>
+			aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
+
+			T* allocate(std::size_t n) { return static_cast<T*>(detail::allocate_aligned(n * sizeof(T), Alignment)); }
+			void deallocate(T* p, std::size_t n) { detail::deallocate_aligned(p, n * sizeof(T), Alignment); }
+		};
+		template <typename T, typename U, std::size_t A>
+		inline bool operator==(const aligned_allocator<T, A>&, const aligned_allocator<U, A>&) { return true; }
+		template <typename T, typename U, std::size_t A>
+		inline bool operator!=(const aligned_allocator<T, A>&, const aligned_allocator<U, A>&) { return false; }
+
+		// Aligned allocator that leaves default-constructed cells uninitialized instead of zeroing them,
+		// so that the pages of a new grid are not touched until its cells are first written; see
+		// parallel_fill() in engine.h.
+		template <typename T, std::size_t Alignment = cache_line>
+		struct uninitialized_allocator : aligned_allocator<T, Alignment>
+		{
+			static_assert(std::is_trivially_default_constructible<T>::value, "uninitialized cells must be trivially constructible");
+
+			template <typename U>
+			struct rebind { typedef uninitialized_allocator<U, Alignment> other; };
+
+			uninitialized_allocator() noexcept {}
+			template <typename U>
+			uninitialized_allocator(const uninitialized_allocator<U, Alignment>&) noexcept {}
+
+			template <typename U>
+			void construct(U* p) noexcept { ::new (static_cast<void*>(p)) U; }
+			template <typename U, typename... Args>
+			void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+		};
+		template <typename T, typename U, std::size_t A>
+		inline bool operator==(const uninitialized_allocator<T, A>&, const uninitialized_allocator<U, A>&) { return true; }
+		template <typename T, typename U, std::size_t A>
+		inline bool operator!=(const uninitialized_allocator<T, A>&, const uninitialized_allocator<U, A>&) { return false; }
+
+		// Preallocated block of memory that hands out cache-line aligned pieces. Released pieces are
+		// kept for requests of the same size, so grids of a job can be created and destroyed repeatedly
+		// without calling malloc() or faulting in fresh pages.
+		class arena
+		{
+			std::size_t capacity;
+			std::size_t used = 0;
+			unsigned char* block;
+			std::unordered_map<std::size_t, std::vector<void*>> released; // by size
+			std::mutex mutex;
+
+			static std::size_t round(std::size_t bytes) { return (std::max<std::size_t>(bytes, 1) + cache_line - 1) / cache_line * cache_line; }
+
+		public:
+			// prefault touches all pages of the arena up front
+			explicit arena(std::size_t bytes, bool prefault = true)
+				: capacity(round(bytes))
+				, block(static_cast<unsigned char*>(detail::allocate_aligned(capacity, cache_line)))
+			{
+				if (prefault)
+					std::memset(block, 0, capacity);
+			}
+			arena(const arena&) = delete;
+			arena& operator=(const arena&) = delete;
+			~arena() { detail::deallocate_aligned(block, capacity, cache_line); }
+
+			void* allocate(std::size_t bytes)
+			{
+				bytes = round(bytes);
+				std::lock_guard<std::mutex> lock(mutex);
+				auto& same = released[bytes];
+				if (not same.empty()) {
+					void* p = same.back();
+					same.pop_back();
+					return p;
+				}
+				if (capacity - used < bytes)
+					throw std::bad_alloc();
+				void* p = block + used;
+				used += bytes;
+				return p;
+			}
+			void deallocate(void* p, std::size_t bytes)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				released[round(bytes)].push_back(p);
+			}
+
+			// bytes handed out at least once
+			inline std::size_t size() const { return used; }
+			inline std::size_t max_size() const { return capacity; }
+		};
+
+		// allocates from an arena
+		template <typename T>
+		struct arena_allocator
+		{
+			static_assert(alignof(T) <= cache_line, "arena pieces are aligned to a cache line");
+
+			typedef T value_type;
+			typedef std::true_type propagate_on_container_copy_assignment;
+			typedef std::true_type propagate_on_container_move_assignment;
+			typedef std::true_type propagate_on_container_swap;
+
+			arena* pool;
+
+			arena_allocator(arena& a) noexcept
+				: pool(&a)
+			{
+			}
+			template <typename U>
+			arena_allocator(const arena_allocator<U>& other) noexcept
+				: pool(other.pool)
+			{
+			}
+
+			T* allocate(std::size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+			void deallocate(T* p, std::size_t n) { pool->deallocate(p, n * sizeof(T)); }
+		};
+		template <typename T, typename U>
+		inline bool operator==(const arena_allocator<T>& lhs, const arena_allocator<U>& rhs) { return lhs.pool == rhs.pool; }
+		template <typename T, typename U>
+		inline bool operator!=(const arena_allocator<T>& lhs, const arena_allocator<U>& rhs) { return lhs.pool != rhs.pool; }
+
+		template <typename T, unsigned R, bool wrap, unsigned... XX>
+		using aligned_grid = basic_grid<std::vector<T, aligned_allocator<T>>, moore, R, wrap, XX...>;
+
+		// the default constructor leaves the cells uninitialized, to be first touched by parallel_fill() or a stencil_engine
+		template <typename T, unsigned R, bool wrap, unsigned... XX>
+		using numa_grid = basic_grid<std::vector<T, uninitialized_allocator<T>>, moore, R, wrap, XX...>;
+
+		// constructed by arena_grid<...>(value, arena)
+		template <typename T, unsigned R, bool wrap, unsigned... XX>
+		using arena_grid = basic_grid<std::vector<T, arena_allocator<T>>, moore, R, wrap, XX...>;
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
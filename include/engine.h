@@ -0,0 +1,562 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_ENGINE_H_
+#define _SPROGAR_HYPERSPACE_ENGINE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		// reusable rendezvous point of a fixed number of threads
+		class barrier
+		{
+			std::mutex mutex;
+			std::condition_variable cv;
+			const unsigned count;
+			unsigned waiting = 0;
+			unsigned generation = 0;
+
+		public:
+			explicit barrier(unsigned n)
+				: count(n)
+			{
+			}
+
+			void arrive_and_wait()
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				const unsigned gen = generation;
+				if (++waiting == count) {
+					waiting = 0;
+					generation += 1;
+					cv.notify_all();
+				}
+				else
+					cv.wait(lock, [&] { return gen != generation; });
+			}
+		};
+
+		// the contiguous share [first, second) of n items that belongs to the worker
+		inline std::pair<position_t, position_t> partition(position_t n, unsigned workers, unsigned worker)
+		{
+			return { n * worker / workers, n * (worker + 1) / workers };
+		}
+
+		// The cells [first, second) of the grid that belong to the worker: its partition() of the outermost
+		// rows. Slabs of vector<bool> grids start at word boundaries, so that workers never share a word.
+		template <class Grid>
+		inline std::pair<position_t, position_t> grid_slab(unsigned workers, unsigned worker)
+		{
+			constexpr position_t grain = std::is_same<typename Grid::reference, std::vector<bool>::reference>::value ? 512 : 1;
+			const position_t outer = Grid::dimension(Grid::dimension() - 1), plane = Grid::size() / outer;
+			auto rows = partition(outer, workers, worker);
+
+			auto align = [](position_t pos) { return pos == Grid::size() ? pos : pos / grain * grain; };
+			return { align(rows.first * plane), align(rows.second * plane) };
+		}
+
+		// Binds the calling thread to the worker's CPU, the worker-th of those the process may run on,
+		// so that it stays next to the memory it first touched. Does nothing where unsupported.
+		inline void pin_thread(unsigned worker)
+		{
+#ifdef __linux__
+			cpu_set_t allowed;
+			if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0 or CPU_COUNT(&allowed) == 0)
+				return;
+			unsigned skip = worker % (unsigned)CPU_COUNT(&allowed);
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+				if (CPU_ISSET(cpu, &allowed) and skip-- == 0) {
+					cpu_set_t one;
+					CPU_ZERO(&one);
+					CPU_SET(cpu, &one);
+					::pthread_setaffinity_np(::pthread_self(), sizeof(one), &one);
+					return;
+				}
+#else
+			(void)worker;
+#endif
+		}
+
+		namespace detail
+		{
+			// pin_thread(worker) while the object lives, if pin; the thread gets its former CPUs back after
+			class scoped_pin
+			{
+#ifdef __linux__
+				cpu_set_t saved;
+				bool restore = false;
+#endif
+
+			public:
+				scoped_pin(bool pin, unsigned worker)
+				{
+#ifdef __linux__
+					if (pin and ::pthread_getaffinity_np(::pthread_self(), sizeof(saved), &saved) == 0) {
+						restore = true;
+						pin_thread(worker);
+					}
+#else
+					(void)pin;
+					(void)worker;
+#endif
+				}
+				scoped_pin(const scoped_pin&) = delete;
+				scoped_pin& operator=(const scoped_pin&) = delete;
+				~scoped_pin()
+				{
+#ifdef __linux__
+					if (restore)
+						::pthread_setaffinity_np(::pthread_self(), sizeof(saved), &saved);
+#endif
+				}
+			};
+
+			// runs job(worker, slab) on the given number of threads, the calling thread being worker 0, and
+			// rethrows the exception of the first failed worker; pinned, the calling thread is bound to its
+			// CPU only until the job is done
+			template <class Grid, class Job>
+			void for_each_slab(unsigned threads, bool pinned, Job job)
+			{
+				const unsigned workers = threads > 0 ? threads : 1;
+				std::vector<std::exception_ptr> errors(workers);
+				auto work = [&](unsigned worker) {
+					try {
+						scoped_pin pin(pinned, worker);
+						job(grid_slab<Grid>(workers, worker));
+					}
+					catch (...) {
+						errors[worker] = std::current_exception();
+					}
+				};
+				std::vector<std::thread> pool;
+				for (unsigned w = 1; w < workers; ++w)
+					pool.emplace_back(work, w);
+				work(0);
+				for (auto& t : pool)
+					t.join();
+				for (const std::exception_ptr& error : errors)
+					if (error)
+						std::rethrow_exception(error);
+			}
+
+			// A grid shaped like the initial one, on a copy of its storage's allocator, with the cells
+			// as the storage leaves them; grids without an allocator are default constructed.
+			template <class Grid>
+			auto blank_like(const Grid& initial, int)
+				-> decltype(Grid(typename std::decay<decltype(initial.storage())>::type(Grid::size(), initial.storage().get_allocator())))
+			{
+				typedef typename std::decay<decltype(initial.storage())>::type storage;
+				return Grid(storage(Grid::size(), initial.storage().get_allocator()));
+			}
+			template <class Grid>
+			Grid blank_like(const Grid&, long) { return Grid(); }
+		} // namespace detail
+
+		// Parallel first-touch initialization: each of the threads writes the cells of its grid_slab(),
+		// the slab it owns in a stencil_engine of as many threads. The OS places a page on the NUMA
+		// node of the thread that touches it first, so the pages of a grid whose storage is left
+		// uninitialized by its constructor (e.g. a numa_grid) end up local to the threads that sweep them.
+		// With pinned, the threads are bound to CPUs as those of a pinned stencil_engine.
+		template <class Grid>
+		void parallel_fill(Grid& g, const typename Grid::value_type& value,
+			unsigned threads = std::thread::hardware_concurrency(), bool pinned = false)
+		{
+			detail::for_each_slab<Grid>(threads, pinned, [&](std::pair<position_t, position_t> cells) {
+				for (position_t pos = cells.first; pos < cells.second; ++pos)
+					g[pos] = value;
+			});
+		}
+		// as parallel_fill(), the cells being f(), which is called concurrently
+		template <class Grid>
+		void parallel_generate(Grid& g, typename Grid::value_type(*f)(),
+			unsigned threads = std::thread::hardware_concurrency(), bool pinned = false)
+		{
+			detail::for_each_slab<Grid>(threads, pinned, [&](std::pair<position_t, position_t> cells) {
+				for (position_t pos = cells.first; pos < cells.second; ++pos)
+					g[pos] = f();
+			});
+		}
+
+		// a cell of a plain buffer, whose neighbors are addressed by offsets
+		template <typename Buffer>
+		struct buffer_cursor
+		{
+			const Buffer* data;
+			position_t pos;
+
+			inline typename Buffer::const_reference operator*() const { return (*data)[pos]; }
+			inline typename Buffer::const_reference operator[](offset_t offset) const { return (*data)[pos + offset]; }
+		};
+
+		// Double-buffered synchronous update of all cells, next = rule(cell, neighbors), spread over a pool
+		// of threads. Each thread owns a slab of the outermost dimension; the threads meet at a barrier
+		// after every step.
+		template <class Grid>
+		class stencil_engine
+		{
+		protected:
+			typedef typename Grid::space_offsets::iterator location;
+
+			Grid buffers[2];
+			unsigned current = 0;
+
+			const unsigned workers;
+			barrier sync;
+			std::vector<std::thread> pool;
+			std::function<void(unsigned)> job;
+			bool stopping = false;
+			std::vector<std::exception_ptr> errors; // of the workers in the current run()
+			std::atomic<bool> failed{ false };
+
+			const bool pinned;
+
+			// the cells [first, second) owned by the worker
+			inline std::pair<position_t, position_t> slab(unsigned worker) const { return grid_slab<Grid>(workers, worker); }
+
+			typedef typename Grid::value_type value_type;
+			typedef std::vector<value_type> buffer;
+
+			static constexpr unsigned R = Grid::space_offsets::radius;
+			static constexpr bool wrap = Grid::space_offsets::wrapped;
+			static constexpr offset_t outer = Grid::dimension(Grid::dimension() - 1);
+			static constexpr offset_t plane = Grid::size() / outer;
+
+			// size of a tile's local buffers that step_blocked() aims at
+			static constexpr std::size_t block_bytes = 1 << 18;
+
+			// Advances the outermost rows [a, b) of src k steps in the local buffers and writes those
+			// of their cells that lie in 'cells' to dst. The buffers hold the R*k surrounding rows as well,
+			// the valid part of which shrinks by R rows on each side per step. In wrapped spaces the rows
+			// are laid out unwrapped, hence the outermost dimension contributes no wrapped offsets.
+			template <class Rule>
+			static void advance_tile(const Grid& src, Grid& dst, offset_t a, offset_t b, unsigned k,
+				std::pair<position_t, position_t> cells, Rule& rule, buffer (&local)[2])
+			{
+				const offset_t halo = (offset_t)R * k;
+				const offset_t lo = wrap ? a - halo : std::max<offset_t>(0, a - halo);
+				const offset_t hi = wrap ? b + halo : std::min<offset_t>(outer, b + halo);
+				constexpr unsigned outer_weight = (unsigned)detail::power(2 * R + 1, Grid::dimension() - 1);
+				auto global = [](offset_t row) { return (row % outer + outer) % outer * plane; };
+
+				for (auto& buf : local)
+					buf.resize((hi - lo) * plane);
+				for (offset_t row = lo; row < hi; ++row)
+					for (offset_t p = 0; p < plane; ++p)
+						local[0][(row - lo) * plane + p] = src[global(row) + p];
+
+				for (unsigned s = 1; s <= k; ++s) {
+					const buffer& in = local[(s - 1) % 2];
+					buffer& out = local[s % 2];
+					const offset_t from = std::max(lo, a - (offset_t)R * (k - s)), to = std::min(hi, b + (offset_t)R * (k - s));
+
+					for (offset_t row = from; row < to; ++row) {
+						location loc(position_t(global(row)));
+						position_t pos = (row - lo) * plane;
+						for (offset_t p = 0; p < plane; ++p, ++pos, ++loc)
+							out[pos] = rule(in[pos], neighbor_view<buffer_cursor<buffer>, typename Grid::space_offsets::neighborhood>(
+								buffer_cursor<buffer>{ &in, pos }, Grid::neighbors_offsets(wrap ? loc.type() % outer_weight : loc.type())));
+					}
+				}
+
+				const position_t first = std::max<position_t>(cells.first, a * plane), last = std::min<position_t>(cells.second, b * plane);
+				for (position_t pos = first; pos < last; ++pos)
+					dst[pos] = local[k % 2][pos - lo * plane];
+			}
+
+			// releases the pool from its barrier and joins it
+			void stop()
+			{
+				stopping = true;
+				if (workers > 1)
+					sync.arrive_and_wait();
+				for (auto& t : pool)
+					t.join();
+			}
+
+			// keeps the exception being handled as the worker's
+			void fail(unsigned worker)
+			{
+				errors[worker] = std::current_exception();
+				failed = true;
+			}
+			// Runs f for the worker unless a worker has failed in this run(), keeping the exception of f.
+			// Jobs guard their work between the barriers this way, so that all workers reach all barriers.
+			template <class F>
+			void guarded(unsigned worker, F&& f)
+			{
+				if (failed)
+					return;
+				try {
+					f();
+				}
+				catch (...) {
+					fail(worker);
+				}
+			}
+
+			void work(unsigned worker)
+			{
+				if (pinned)
+					pin_thread(worker);
+				for (;;) {
+					sync.arrive_and_wait();
+					if (stopping)
+						return;
+					try {
+						job(worker);
+					}
+					catch (...) {
+						fail(worker);
+					}
+					sync.arrive_and_wait();
+				}
+			}
+
+			// Runs the job on all workers, the calling thread being worker 0, and waits for all of them to
+			// finish. Rethrows the exception of the first failed worker once all have finished.
+			void run(std::function<void(unsigned)> f)
+			{
+				job = std::move(f);
+				errors.assign(workers, nullptr);
+				failed = false;
+				if (workers > 1)
+					sync.arrive_and_wait();
+				{
+					detail::scoped_pin pin(pinned, 0);
+					try {
+						job(0);
+					}
+					catch (...) {
+						fail(0);
+					}
+				}
+				if (workers > 1)
+					sync.arrive_and_wait();
+				for (const std::exception_ptr& error : errors)
+					if (error)
+						std::rethrow_exception(error);
+			}
+
+		public:
+			// The buffers take the allocator of the initial grid's storage, and each worker copies its
+			// slab of the initial grid to them, so buffers whose storage is left uninitialized (e.g. of a
+			// numa_grid) are first touched by the worker that owns the slab. With pinned, worker w is
+			// bound to the w-th CPU the process may run on; the calling thread, worker 0, only while it
+			// runs its share of the construction or of a step() and gets its former CPUs back after.
+			stencil_engine(const Grid& initial, unsigned threads = std::thread::hardware_concurrency(), bool pinned = false)
+				: buffers{ detail::blank_like(initial, 0), detail::blank_like(initial, 0) }
+				, workers(threads > 0 ? threads : 1)
+				, sync(threads > 0 ? threads : 1)
+				, pinned(pinned)
+			{
+				for (unsigned w = 1; w < workers; ++w)
+					pool.emplace_back(&stencil_engine::work, this, w);
+				try {
+					run([this, &initial](unsigned worker) {
+						const auto cells = slab(worker);
+						for (position_t pos = cells.first; pos < cells.second; ++pos)
+							buffers[0][pos] = buffers[1][pos] = initial[pos];
+					});
+				}
+				catch (...) {
+					stop();
+					throw;
+				}
+			}
+			stencil_engine(const stencil_engine&) = delete;
+			stencil_engine& operator=(const stencil_engine&) = delete;
+
+			~stencil_engine() { stop(); }
+
+			inline unsigned threads() const { return workers; }
+
+			inline Grid& state() { return buffers[current]; }
+			inline const Grid& state() const { return buffers[current]; }
+
+			// Advances all cells n times by rule(cell, neighbor_view). An exception of the rule is rethrown
+			// once all workers have stopped; the state may then be partially updated.
+			template <class Rule>
+			void step(unsigned n, Rule rule)
+			{
+				run([this, n, &rule](unsigned worker) {
+					const auto cells = slab(worker);
+
+					for (unsigned s = 0; s < n; ++s) {
+						const Grid& src = buffers[(current + s) % 2];
+						Grid& dst = buffers[(current + s + 1) % 2];
+
+						guarded(worker, [&] {
+							auto it = src.begin();
+							it._loc = location(cells.first);
+							for (position_t pos = cells.first; pos < cells.second; ++pos, ++it)
+								dst[pos] = rule(*it, neighbor_view<typename Grid::const_iterator,
+									typename Grid::space_offsets::neighborhood>(it, it.neighbors_offsets()));
+						});
+
+						if (workers > 1 && s + 1 < n)
+							sync.arrive_and_wait();
+					}
+				});
+				current = (current + n) % 2;
+			}
+
+			// Advances all cells n times like step(n, rule), but in rounds of k steps (temporal blocking):
+			// every slab is cut into tiles of tile_rows outermost rows, each of which is advanced k steps
+			// in a cache-sized local buffer before the next tile is loaded. The grid is thus streamed
+			// through memory once per k steps. The results equal those of step(n, rule); the rule receives
+			// a neighbor_view of the local buffer. tile_rows = 0 sizes the buffers to about block_bytes.
+			template <class Rule>
+			void step_blocked(unsigned n, unsigned k, Rule rule, position_t tile_rows = 0)
+			{
+				assert(k > 0);
+				// the rows of a wrapped tile must not be wrapped neighbors of each other
+				if (wrap and outer < 2 * R + 1) {
+					step(n, rule);
+					return;
+				}
+				if (tile_rows == 0)
+					tile_rows = std::max<position_t>(2 * R * k, block_bytes / (plane * sizeof(value_type)));
+
+				const unsigned rounds = (n + k - 1) / k;
+				run([&](unsigned worker) {
+					const auto cells = slab(worker);
+					const offset_t first_row = cells.first / plane;
+					const offset_t last_row = cells.first < cells.second ? (cells.second + plane - 1) / plane : first_row;
+					buffer local[2];
+
+					for (unsigned round = 0; round < rounds; ++round) {
+						const Grid& src = buffers[(current + round) % 2];
+						Grid& dst = buffers[(current + round + 1) % 2];
+						const unsigned steps = std::min(k, n - round * k);
+
+						guarded(worker, [&] {
+							for (offset_t a = first_row; a < last_row; a += tile_rows)
+								advance_tile(src, dst, a, std::min<offset_t>(last_row, a + tile_rows), steps, cells, rule, local);
+						});
+
+						if (workers > 1 && round + 1 < rounds)
+							sync.arrive_and_wait();
+					}
+				});
+				current = (current + rounds) % 2;
+			}
+		};
+
+		// Synchronous update of a sparse activity: only the cells whose neighborhood (or the cell itself)
+		// changed in the previous step are evaluated, so the cost of a step scales with the activity
+		// rather than with the size of the grid. The rule must be a function of the cell and its neighbors.
+		template <class Grid>
+		class incremental_engine
+		{
+		protected:
+			typedef typename Grid::space_offsets::iterator location;
+			typedef typename Grid::value_type value_type;
+
+			Grid cells;
+			std::vector<position_t> active; // cells to evaluate in the next step, each listed once
+			std::vector<bool> marked; // membership in 'active'
+			std::vector<std::pair<position_t, value_type>> changes;
+
+			// schedules the cell and its neighbors for evaluation
+			void touch(position_t pos)
+			{
+				auto mark = [this](position_t p) {
+					if (not marked[p]) {
+						marked[p] = true;
+						active.push_back(p);
+					}
+				};
+				mark(pos);
+				// the cells that may see this one among their neighbors, whatever the policy
+				for (offset_t off : Grid::space_offsets::moore_offsets::neighbors_offsets(location(pos).type()))
+					mark(pos + off);
+			}
+
+		public:
+			incremental_engine(const Grid& initial)
+				: cells(initial)
+				, active(Grid::size())
+				, marked(Grid::size(), true)
+			{
+				for (position_t pos = 0; pos < Grid::size(); ++pos)
+					active[pos] = pos;
+			}
+
+			inline const Grid& state() const { return cells; }
+			inline position_t active_cells() const { return active.size(); }
+
+			// changes a cell from the outside
+			void assign(position_t pos, const value_type& value)
+			{
+				cells[pos] = value;
+				touch(pos);
+			}
+
+			// advances all cells n times by rule(cell, neighbor_view)
+			template <class Rule>
+			void step(unsigned n, Rule rule)
+			{
+				const Grid& src = cells;
+				for (unsigned s = 0; s < n and not active.empty(); ++s) {
+					std::sort(active.begin(), active.end());
+					for (position_t pos : active) {
+						auto it = src.begin();
+						it._loc = location(pos);
+						value_type next = rule(*it, neighbor_view<typename Grid::const_iterator,
+							typename Grid::space_offsets::neighborhood>(it, it.neighbors_offsets()));
+						if (next != *it)
+							changes.emplace_back(pos, next);
+						marked[pos] = false;
+					}
+					active.clear();
+
+					for (const auto& change : changes) {
+						cells[change.first] = change.second;
+						touch(change.first);
+					}
+					changes.clear();
+				}
+			}
+		};
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
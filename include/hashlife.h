@@ -0,0 +1,392 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_HASHLIFE_H_
+#define _SPROGAR_HYPERSPACE_HASHLIFE_H_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		// Hashlife: the space is a hash-consed tree of cubes, each made of 2^D half-sized cubes, and
+		// the future of every distinct cube is computed only once. Periodic and sparse patterns thus
+		// advance an exponential number of generations in polynomial time.
+		// The rule is a totalistic rule(count, alive) over the Moore neighborhood of radius 1.
+		// A wrapped space is simulated as the infinite tiling of itself, which requires all extents to be
+		// powers of two (and at least 4, so that no cell is its own wrapped neighbor). An unwrapped space
+		// is embedded in a sea of walls, cells which never change and are not counted as neighbors.
+		template <bool wrap, unsigned... XX>
+		class hashlife
+		{
+			static_assert(sizeof...(XX) > 0, "hashlife needs at least one dimension");
+
+		public:
+			typedef grid<bool, 1, wrap, XX...> grid_type;
+
+			static constexpr unsigned D = sizeof...(XX);
+			static constexpr unsigned C = 1U << D; // children of a node
+
+			enum cell : unsigned char { dead, alive, wall };
+
+			struct node
+			{
+				std::array<const node*, C> child; // bit d of the index selects the upper half of dimension d
+				unsigned level; // the node is a cube of 2^level cells per dimension
+				cell state; // of a leaf (level 0)
+			};
+
+		private:
+			// extent of dimension d, d = 0 being the innermost
+			static constexpr unsigned extent(unsigned d)
+			{
+				constexpr std::array<unsigned, D> xx{ { XX... } };
+				return xx[D - 1 - d];
+			}
+			static constexpr unsigned space_level()
+			{
+				unsigned level = 0;
+				for (unsigned d = 0; d < D; ++d)
+					while ((1U << level) < extent(d))
+						level += 1;
+				return level;
+			}
+			static constexpr bool valid_torus()
+			{
+				for (unsigned d = 0; d < D; ++d)
+					if (extent(d) < 4 or (extent(d) & (extent(d) - 1)) != 0)
+						return false;
+				return true;
+			}
+			static_assert(not wrap or valid_torus(), "wrapped hashlife extents must be powers of two, at least 4");
+
+			// the space is a cube of 2^M cells per dimension
+			static constexpr unsigned M = space_level();
+
+			typedef std::array<position_t, D> coordinates;
+
+			struct children_hash
+			{
+				std::size_t operator()(const std::array<const node*, C>& children) const
+				{
+					std::size_t h = 0;
+					for (const node* n : children)
+						h = h * 1000003 ^ std::hash<const node*>()(n);
+					return h;
+				}
+			};
+			struct result_hash
+			{
+				std::size_t operator()(const std::pair<const node*, unsigned>& key) const
+				{
+					return std::hash<const node*>()(key.first) * 31 + key.second;
+				}
+			};
+
+			std::deque<node> nodes; // never moves its elements
+			std::unordered_map<std::array<const node*, C>, const node*, children_hash> unique;
+			std::unordered_map<std::pair<const node*, unsigned>, const node*, result_hash> results;
+			std::vector<const node*> walls; // the uniform wall cube of each level
+			const node* leaves[3];
+
+			std::function<bool(int, bool)> rule;
+			std::size_t max_nodes;
+			const node* space; // the cube of level M, the space occupying its lowest corner
+			std::uint64_t generations = 0;
+
+			const node* make(const std::array<const node*, C>& children)
+			{
+				auto found = unique.find(children);
+				if (found != unique.end())
+					return found->second;
+
+				nodes.push_back(node{ children, children[0]->level + 1, dead });
+				return unique[children] = &nodes.back();
+			}
+			const node* uniform(const node* n, unsigned level)
+			{
+				while (n->level < level) {
+					std::array<const node*, C> children;
+					children.fill(n);
+					n = make(children);
+				}
+				return n;
+			}
+			const node* wall_cube(unsigned level)
+			{
+				while (walls.size() <= level)
+					walls.push_back(walls.empty() ? leaves[wall] : uniform(walls.back(), (unsigned)walls.size()));
+				return walls[level];
+			}
+
+			// the grandchild at coordinates g (each 0..3, in units of grandchildren) of a node
+			static const node* grandchild(const node* n, const std::array<unsigned, D>& g)
+			{
+				unsigned upper = 0, lower = 0;
+				for (unsigned d = 0; d < D; ++d) {
+					upper |= (g[d] >> 1) << d;
+					lower |= (g[d] & 1) << d;
+				}
+				return n->child[upper]->child[lower];
+			}
+
+			// the center of a level 2 node one generation later
+			const node* base_result(const node* n)
+			{
+				std::array<const node*, C> center;
+				for (unsigned q = 0; q < C; ++q) {
+					std::array<unsigned, D> c;
+					for (unsigned d = 0; d < D; ++d)
+						c[d] = 1 + ((q >> d) & 1);
+
+					const cell self = grandchild(n, c)->state;
+					if (self == wall) {
+						center[q] = leaves[wall];
+						continue;
+					}
+					int count = 0;
+					for (unsigned k = 0; k < detail::power(3, D); ++k) {
+						std::array<unsigned, D> nc;
+						unsigned rest = k;
+						for (unsigned d = 0; d < D; ++d, rest /= 3)
+							nc[d] = c[d] + rest % 3 - 1;
+						if (nc != c)
+							count += grandchild(n, nc)->state == alive;
+					}
+					center[q] = leaves[rule(count, self == alive) ? alive : dead];
+				}
+				return make(center);
+			}
+
+			// the central half of a node
+			const node* center(const node* n)
+			{
+				std::array<const node*, C> children;
+				for (unsigned q = 0; q < C; ++q)
+					children[q] = n->child[q]->child[(C - 1) ^ q];
+				return make(children);
+			}
+
+			// The central half of a node of level k, 2^j generations later (j <= k - 2). The node is
+			// cut into 3^D overlapping half-sized nodes, whose centers are advanced by the first half
+			// of the generations (if any), and regrouped into 2^D nodes, which advance the rest.
+			const node* result(const node* n, unsigned j)
+			{
+				const unsigned k = n->level;
+				assert(k >= 2 and j <= k - 2);
+				auto found = results.find({ n, j });
+				if (found != results.end())
+					return found->second;
+				if (k == 2)
+					return results[{ n, j }] = base_result(n);
+
+				const bool full = j == k - 2;
+
+				constexpr unsigned S = (unsigned)detail::power(3, D);
+				std::array<const node*, S> inner;
+				for (unsigned p = 0; p < S; ++p) {
+					std::array<unsigned, D> origin;
+					unsigned rest = p;
+					for (unsigned d = 0; d < D; ++d, rest /= 3)
+						origin[d] = rest % 3;
+
+					std::array<const node*, C> children;
+					for (unsigned q = 0; q < C; ++q) {
+						std::array<unsigned, D> g;
+						for (unsigned d = 0; d < D; ++d)
+							g[d] = origin[d] + ((q >> d) & 1);
+						children[q] = grandchild(n, g);
+					}
+					const node* sub = make(children);
+					inner[p] = full ? result(sub, k - 3) : center(sub);
+				}
+
+				std::array<const node*, C> outer;
+				for (unsigned q = 0; q < C; ++q) {
+					std::array<const node*, C> children;
+					for (unsigned r = 0; r < C; ++r) {
+						unsigned p = 0;
+						for (unsigned d = D; d-- > 0;)
+							p = p * 3 + ((q >> d) & 1) + ((r >> d) & 1);
+						children[r] = inner[p];
+					}
+					outer[q] = result(make(children), full ? k - 3 : j);
+				}
+				return results[{ n, j }] = make(outer);
+			}
+
+			// the node of the given level that holds the space at offset 2^(level-2) in every dimension
+			const node* context(unsigned level)
+			{
+				if (wrap)
+					return uniform(space, level);
+
+				const node* corner = space;
+				for (unsigned l = M; l < level - 2; ++l) {
+					std::array<const node*, C> children;
+					children.fill(wall_cube(l));
+					children[0] = corner;
+					corner = make(children);
+				}
+				std::array<const node*, C> children;
+				children.fill(wall_cube(level - 2));
+				children[C - 1] = corner;
+				const node* quarter = make(children);
+
+				children.fill(wall_cube(level - 1));
+				children[0] = quarter;
+				return make(children);
+			}
+
+			const node* build(unsigned level, const coordinates& origin, const grid_type& initial)
+			{
+				if (level == 0) {
+					position_t pos = 0;
+					for (unsigned d = D; d-- > 0;) {
+						if (origin[d] >= extent(d))
+							return leaves[wall]; // only unwrapped spaces are smaller than the cube
+						pos = pos * extent(d) + origin[d];
+					}
+					return leaves[initial[pos] ? alive : dead];
+				}
+
+				std::array<const node*, C> children;
+				for (unsigned q = 0; q < C; ++q) {
+					coordinates c = origin;
+					for (unsigned d = 0; d < D; ++d)
+						c[d] = wrap ? (c[d] + ((q >> d) & 1) * (position_t(1) << (level - 1))) % extent(d)
+							: c[d] + ((q >> d) & 1) * (position_t(1) << (level - 1));
+					children[q] = build(level - 1, c, initial);
+				}
+				return make(children);
+			}
+
+			// the copy of n among the nodes made after a collection
+			const node* keep(const node* n, std::unordered_map<const node*, const node*>& kept)
+			{
+				auto found = kept.find(n);
+				if (found != kept.end())
+					return found->second;
+				std::array<const node*, C> children;
+				for (unsigned q = 0; q < C; ++q)
+					children[q] = keep(n->child[q], kept);
+				return kept[n] = make(children);
+			}
+
+			static void paint(const node* n, const coordinates& origin, grid_type& out)
+			{
+				for (unsigned d = 0; d < D; ++d)
+					if (origin[d] >= extent(d))
+						return;
+				if (n->level == 0) {
+					position_t pos = 0;
+					for (unsigned d = D; d-- > 0;)
+						pos = pos * extent(d) + origin[d];
+					out[pos] = n->state == alive;
+					return;
+				}
+				for (unsigned q = 0; q < C; ++q) {
+					coordinates c = origin;
+					for (unsigned d = 0; d < D; ++d)
+						c[d] += ((q >> d) & 1) * (position_t(1) << (n->level - 1));
+					paint(n->child[q], c, out);
+				}
+			}
+
+		public:
+			// The nodes and memoized results are collected before an advance once they exceed max_nodes
+			// nodes, so the tables hold at most max_nodes plus the nodes created by a single advance.
+			hashlife(const grid_type& initial, std::function<bool(int, bool)> totalistic_rule, std::size_t max_nodes = std::size_t(1) << 20)
+				: rule(std::move(totalistic_rule))
+				, max_nodes(max_nodes)
+			{
+				for (cell c : { dead, alive, wall }) {
+					nodes.push_back(node{ {}, 0, c });
+					leaves[c] = &nodes.back();
+				}
+				space = build(M, coordinates{}, initial);
+			}
+			hashlife(const hashlife&) = delete;
+			hashlife& operator=(const hashlife&) = delete;
+
+			// drops the memoized results and all nodes but those of the current space
+			void clear_cache()
+			{
+				std::deque<node> old;
+				old.swap(nodes);
+				unique.clear();
+				results.clear();
+				walls.clear();
+
+				std::unordered_map<const node*, const node*> kept;
+				for (cell c : { dead, alive, wall }) {
+					nodes.push_back(node{ {}, 0, c });
+					kept[leaves[c]] = &nodes.back();
+					leaves[c] = &nodes.back();
+				}
+				space = keep(space, kept);
+			}
+
+			// advances the space 2^k generations
+			void advance(unsigned k)
+			{
+				if (nodes.size() > max_nodes)
+					clear_cache();
+				const unsigned level = std::max(k + 2, M + 2);
+				const node* n = result(context(level), k);
+				while (n->level > M)
+					n = n->child[0];
+				space = n;
+				generations += std::uint64_t(1) << k;
+			}
+
+			// advances the space n generations
+			void step(std::uint64_t n)
+			{
+				for (unsigned k = 0; n != 0; ++k, n >>= 1)
+					if (n & 1)
+						advance(k);
+			}
+
+			inline std::uint64_t generation() const { return generations; }
+			inline std::size_t node_count() const { return nodes.size(); }
+
+			grid_type state() const
+			{
+				grid_type out(false);
+				paint(space, coordinates{}, out);
+				return out;
+			}
+		};
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
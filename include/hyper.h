@@ -21,11 +21,17 @@
 #ifndef _SPROGAR_HYPERSPACE_H_
 #define _SPROGAR_HYPERSPACE_H_
 
+#include <algorithm>
+#include <array>
 #include <cassert>
-#include <cmath>
+#include <cstdint>
 #include <functional>
-#include <map>
-#include <set>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <string>
 
@@ -36,6 +42,45 @@ namespace sprogar
 
 	namespace hyper
 	{
+		namespace detail
+		{
+			constexpr std::size_t power(std::size_t base, unsigned exponent)
+			{
+				return exponent == 0 ? 1 : base * power(base, exponent - 1);
+			}
+
+			// positions and offsets between them must fit offset_t
+			constexpr position_t max_cells = (position_t)std::numeric_limits<offset_t>::max();
+
+			// iterator arithmetic takes any integer, so that it is preferred to the conversion to position_t
+			template <typename N>
+			using if_integral = typename std::enable_if<std::is_integral<N>::value, int>::type;
+
+			// boundary conditions map an outlying coordinate and the extent to a coordinate
+			template <typename F>
+			using if_boundary = typename std::enable_if<std::is_invocable_r<offset_t, F, offset_t, offset_t>::value, int>::type;
+
+			// n cells made by f in order: appended to storage that grows, such as std::vector,
+			// and assigned to storage of a fixed size, such as a mapped file
+			template <typename Storage, typename F>
+			auto generate(position_t n, F f, int) -> decltype(std::declval<Storage&>().push_back(f()), Storage())
+			{
+				Storage data;
+				data.reserve(n);
+				while (data.size() < n)
+					data.push_back(f());
+				return data;
+			}
+			template <typename Storage, typename F>
+			Storage generate(position_t n, F f, long)
+			{
+				Storage data(n);
+				for (position_t pos = 0; pos < n; ++pos)
+					data[pos] = f();
+				return data;
+			}
+		} // namespace detail
+
 		template <unsigned R, unsigned... XX>
 		class location_iterator
 		{
@@ -46,20 +91,19 @@ namespace sprogar
 					: value(u) {};
 			};
 			position_t pos1d;
+			unsigned hood; // neighborhood type, maintained by the derived dimensions
 
-			location_iterator(position_t, dummy pos) : pos1d{ pos.value }
+			location_iterator(position_t, dummy pos) : pos1d{ pos.value }, hood{ 0 }
 			{
 			}
-			location_iterator(dummy pos, position_t = 0) : pos1d{ pos.value }
+			location_iterator(dummy pos, position_t = 0) : pos1d{ pos.value }, hood{ 0 }
 			{
 			}
 
-			template <unsigned>
-			inline unsigned neighborhood_type() const { return 0; }
 			inline void increment() {}
 
 		public:
-			location_iterator() : pos1d{ 0 }
+			location_iterator() : pos1d{ 0 }, hood{ 0 }
 			{
 			}
 
@@ -113,12 +157,6 @@ namespace sprogar
 
 			static inline location_iterator begin() { return location_iterator(); }
 			static inline location_iterator end() { return location_iterator(); }
-
-			template <bool>
-			inline unsigned make_offset(std::set<offset_t>&, offset_t, unsigned) const
-			{
-				return 1;
-			}
 		};
 
 
@@ -126,6 +164,9 @@ namespace sprogar
 		template <unsigned R, unsigned X, unsigned... XX>
 		class location_iterator<R, X, XX...> : public location_iterator<R, XX...>
 		{
+			static_assert(X == 0 or location_iterator<R, XX...>::size() <= detail::max_cells / X, "too many cells for position_t");
+			static_assert(detail::power(2 * R + 1, 1 + sizeof...(XX)) <= std::numeric_limits<unsigned>::max(), "too many neighborhood types");
+
 		public:
 			typedef location_iterator<R> root;
 			typedef location_iterator<R, XX...> base;
@@ -133,50 +174,50 @@ namespace sprogar
 			unsigned coordinate;
 
 		protected:
+			// the contribution of this dimension to the neighborhood type; inner dimensions are less significant
+			static constexpr unsigned weight = (unsigned)detail::power(2 * R + 1, sizeof...(XX));
+
+			// 0 for interior coordinates, 1..R for the first R and R+1..2R for the last R coordinates
+			static inline constexpr unsigned kind(unsigned c)
+			{
+				return c < R ? 1 + c : c > X - R - 1 ? 2 * R - (X - 1 - c) : 0;
+			}
+
 			// construct by coordinates
 			template <typename... CC>
 			location_iterator(typename root::dummy pos, unsigned c, CC... cc)
 				: base(typename root::dummy(pos.value* X + c), cc...), coordinate(c)
 			{
+				root::hood += kind(coordinate) * weight;
 			}
 			// construct by id
-			location_iterator(unsigned c, typename root::dummy pos)
-				: base((unsigned)(c% base::size()), pos), coordinate((unsigned)(c / base::size()))
+			location_iterator(position_t c, typename root::dummy pos)
+				: base(c % base::size(), pos), coordinate((unsigned)(c / base::size()))
 			{
+				root::hood += kind(coordinate) * weight;
 			}
 
-			template <unsigned D>
-			inline unsigned neighborhood_type() const
-			{
-				unsigned typ = 0;
-
-				if (coordinate < R)
-					typ = D * (1 + coordinate);
-				else if (coordinate > X - R - 1)
-					typ = 2 * R * D - D * (X - 1 - coordinate);
-
-				typ += base::template neighborhood_type<D* (2 * R + 1)>();
-				return typ;
-			}
 			inline bool move_next()
 			{
 				if (base::move_next()) {
+					const unsigned old = kind(coordinate);
 					coordinate += 1;
-					if (coordinate == X) {
+					const bool carry = coordinate == X;
+					if (carry)
 						coordinate = 0;
-						return true;
-					}
+					root::hood += (kind(coordinate) - old) * weight;
+					return carry;
 				}
 				return false;
 			}
 			inline bool move_prev()
 			{
 				if (base::move_prev()) {
-					if (coordinate == 0) {
-						coordinate = X - 1;
-						return true;
-					}
-					coordinate -= 1;
+					const unsigned old = kind(coordinate);
+					const bool borrow = coordinate == 0;
+					coordinate = borrow ? X - 1 : coordinate - 1;
+					root::hood += (kind(coordinate) - old) * weight;
+					return borrow;
 				}
 				return false;
 			}
@@ -184,16 +225,19 @@ namespace sprogar
 		public:
 			location_iterator() : base(), coordinate(0)
 			{
+				root::hood += kind(coordinate) * weight;
 			}
 
 			template <typename... CC>
 			location_iterator(unsigned c, CC... cc) : base(typename root::dummy{ c }, cc...), coordinate(c)
 			{
+				root::hood += kind(coordinate) * weight;
 			}
 
 			location_iterator(position_t pos) :
-				base((unsigned)(pos% base::size()), typename root::dummy{ pos }), coordinate((unsigned)(pos / base::size()))
+				base(pos % base::size(), typename root::dummy{ pos }), coordinate((unsigned)(pos / base::size()))
 			{
+				root::hood += kind(coordinate) * weight;
 			}
 
 			inline static constexpr std::size_t size() { return X * base::size(); }
@@ -219,7 +263,7 @@ namespace sprogar
 
 			inline operator position_t() const { return root::pos1d; }
 
-			inline unsigned type() const { return neighborhood_type<1>(); }
+			inline unsigned type() const { return root::hood; }
 
 			inline location_iterator& operator++()
 			{
@@ -244,6 +288,15 @@ namespace sprogar
 				return old;
 			}
 
+			// jumps n cells in O(D), i.e. reconstructs the iterator at the new position
+			inline location_iterator& operator+=(offset_t n)
+			{
+				const position_t pos = (position_t)((offset_t)root::pos1d + n);
+				assert(pos <= size());
+				return *this = pos == size() ? end() : location_iterator(pos);
+			}
+			inline location_iterator& operator-=(offset_t n) { return *this += -n; }
+
 			static inline location_iterator begin() { return location_iterator(); }
 			static inline location_iterator end()
 			{
@@ -251,61 +304,6 @@ namespace sprogar
 				loc.pos1d = loc.size();
 				return loc;
 			}
-
-			template <bool wrap>
-			unsigned make_offset(std::set<offset_t>& set, offset_t offset, unsigned plane) const
-			{
-				plane = base::template make_offset<wrap>(set, offset, plane);
-
-				if (coordinate != 0) {
-					unsigned P = base::template make_offset<wrap>(set, offset - plane, plane);
-					set.insert(offset - P);
-				}
-				else if (wrap) {
-					unsigned P = base::template make_offset<wrap>(set, offset + (X - 1) * plane, plane);
-					set.insert(offset + (X - 1) * P);
-				}
-
-				set.insert(offset);
-
-				if (coordinate != X - 1) {
-					unsigned P = base::template make_offset<wrap>(set, offset + plane, plane);
-					set.insert(offset + P);
-				}
-				else if (wrap) {
-					unsigned P = base::template make_offset<wrap>(set, offset - (X - 1) * plane, plane);
-					set.insert(offset - (X - 1) * P);
-				}
-
-				return X * plane;
-			}
-			template <bool wrap>
-			std::vector<offset_t> make_offset()
-			{
-				std::set<offset_t> total;
-				make_offset<wrap>(total, 0, 1);
-				total.erase(0);
-
-				for (unsigned r = 1; r < R; ++r)
-				{
-					std::set<offset_t> todo(total);
-					for (offset_t off : todo) {
-						location_iterator it(root::pos1d + off);
-
-						std::set<offset_t> ring;
-						it.template make_offset<wrap>(ring, 0, 1);
-
-						for (offset_t x : ring)
-							total.insert(off + x);
-						total.erase(0);
-					}
-				}
-
-				std::vector<offset_t> vec;
-				vec.insert(vec.begin(), total.begin(), total.end());
-
-				return vec;
-			}
 		};
 
 
@@ -315,8 +313,8 @@ namespace sprogar
 		class iterable_space
 		{
 		protected:
-			template <unsigned>
-			static inline unsigned id_helper() { return 0; }
+			template <position_t>
+			static inline position_t id_helper() { return 0; }
 
 		public:
 			static inline constexpr std::string info() {
@@ -334,9 +332,11 @@ namespace sprogar
 		template <bool wrap, unsigned R, unsigned X, unsigned... XX>
 		class iterable_space<wrap, R, X, XX...> : public iterable_space<wrap, R, XX...>
 		{
+			static_assert(X == 0 or iterable_space<wrap, R, XX...>::size() <= detail::max_cells / X, "too many cells for position_t");
+
 		protected:
-			template <unsigned S, typename... UU>
-			static inline unsigned id_helper(unsigned x, UU... uu)
+			template <position_t S, typename... UU>
+			static inline position_t id_helper(unsigned x, UU... uu)
 			{
 				assert(x < X);
 				return x * S + iterable_space<wrap, R, XX...>::template id_helper<X* S>(uu...);
@@ -354,56 +354,217 @@ namespace sprogar
 			}
 			static inline constexpr position_t size() { return X * iterable_space<wrap, R, XX...>::size(); }
 			template <typename... UU>
-			static inline unsigned id(UU... uu)
+			static inline position_t id(UU... uu)
 			{
 				assert(sizeof...(UU) == 1 + sizeof...(XX));
-				return id_helper<1U>(static_cast<unsigned>(uu)...);
+				return id_helper<1>(static_cast<unsigned>(uu)...);
 			}
 
 			static inline constexpr location_iterator<R, X, XX...> begin() { return location_iterator<R, X, XX...>::begin(); }
 			static inline constexpr location_iterator<R, X, XX...> end() { return location_iterator<R, X, XX...>::end(); }
 		};
 
-		template <bool wrap, unsigned R, unsigned... XX>
-		std::vector<std::vector<offset_t>> make_neighborhoods()
+		// fixed-capacity list of a cell's neighbors' offsets
+		template <std::size_t N>
+		struct neighborhood
+		{
+			std::array<offset_t, N> offsets{};
+			std::size_t count = 0;
+
+			inline constexpr const offset_t* begin() const { return offsets.data(); }
+			inline constexpr const offset_t* end() const { return offsets.data() + count; }
+			inline constexpr std::size_t size() const { return count; }
+			inline constexpr offset_t operator[](std::size_t i) const { return offsets[i]; }
+		};
+
+		template <std::size_t N>
+		inline bool operator==(const neighborhood<N>& lhs, const std::vector<offset_t>& rhs)
+		{
+			return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+		}
+		template <std::size_t N>
+		inline bool operator==(const std::vector<offset_t>& lhs, const neighborhood<N>& rhs) { return rhs == lhs; }
+		template <std::size_t N>
+		inline bool operator!=(const neighborhood<N>& lhs, const std::vector<offset_t>& rhs) { return !(lhs == rhs); }
+		template <std::size_t N>
+		inline bool operator!=(const std::vector<offset_t>& lhs, const neighborhood<N>& rhs) { return !(rhs == lhs); }
+
+		// Neighborhood policies select the neighbors among the (2R+1)^D - 1 cells of the surrounding box.
+		// contains(delta, D, R) is given the displacement of a cell, outermost dimension first, each
+		// within [-R, R]; wrapped spaces smaller than the box may reach a cell by several displacements.
+		struct moore
+		{
+			static constexpr bool contains(const offset_t*, unsigned, offset_t) { return true; }
+		};
+		// cells within the L1 distance R, i.e. 2D neighbors for R = 1
+		struct von_neumann
+		{
+			static constexpr bool contains(const offset_t* delta, unsigned D, offset_t R)
+			{
+				offset_t distance = 0;
+				for (unsigned d = 0; d < D; ++d)
+					distance += delta[d] < 0 ? -delta[d] : delta[d];
+				return distance <= R;
+			}
+		};
+		// the listed displacements, D coordinates each, outermost first, e.g. mask<-1, 0, 0, 1> in 2D
+		template <int... Deltas>
+		struct mask
+		{
+			static constexpr bool contains(const offset_t* delta, unsigned D, offset_t)
+			{
+				constexpr int list[] = { Deltas... };
+				assert(sizeof...(Deltas) % D == 0);
+				for (std::size_t i = 0; i < sizeof...(Deltas); i += D) {
+					unsigned d = 0;
+					while (d < D and list[i + d] == delta[d])
+						d += 1;
+					if (d == D)
+						return true;
+				}
+				return false;
+			}
+		};
+
+		namespace detail
 		{
-			std::map<unsigned, std::vector<offset_t>> M;
+			constexpr unsigned max_policy_dimension = 64;
+
+			// coordinate shared by all cells of the given kind (see location_iterator::kind())
+			// in a dimension of size X, or -1 if no such cell exists
+			constexpr offset_t kind_coordinate(offset_t kind, offset_t X, offset_t R)
+			{
+				if (kind == 0)
+					return X >= 2 * R + 1 ? R : -1;
+				if (kind <= R)
+					return kind - 1 < X ? kind - 1 : -1;
+				return X - 1 - (2 * R - kind) >= R ? X - 1 - (2 * R - kind) : -1;
+			}
 
-			auto loc = location_iterator<R, XX...>::begin(), loc_end = location_iterator<R, XX...>::end();
-			for (; loc != loc_end; ++loc) {
-				unsigned typ = loc.type();
-				if (M.find(typ) == M.end())
-					M[typ] = loc.template make_offset<wrap>();
+			// tells whether any combination of the candidate displacements (bit R+l of candidates[d] for
+			// the displacement l in dimension d) is a neighbor by the given policy
+			template <class Hood>
+			constexpr bool accepts(const std::uint64_t* candidates, unsigned D, offset_t R, unsigned d, offset_t* delta)
+			{
+				if (d == D)
+					return Hood::contains(delta, D, R);
+				for (offset_t l = -R; l <= R; ++l)
+					if ((candidates[d] >> (l + R)) & 1) {
+						delta[d] = l;
+						if (accepts<Hood>(candidates, D, R, d + 1, delta))
+							return true;
+					}
+				return false;
 			}
 
-			std::vector<std::vector<offset_t>> ret((unsigned)std::pow(2 * R + 1, sizeof...(XX)));
+			// Appends the offsets of the neighborhood of the given type, starting at dimension d, to 'out'.
+			// Per dimension, the distinct displacements of the neighbors form at most three ascending ranges
+			// (wrapped from above, direct, wrapped from below), which makes the resulting offsets sorted.
+			// Policies other than moore are asked about the displacements (within [-R, R]) that reach each cell.
+			template <class Hood, typename Extents, typename Offsets>
+			constexpr void make_neighborhood(const Extents& extent, unsigned d, offset_t R, bool wrap,
+				std::size_t hood_type, offset_t offset, Offsets& out, std::size_t& count, std::uint64_t* candidates)
+			{
+				if (d == extent.size()) {
+					offset_t delta[max_policy_dimension]{};
+					if (offset != 0 and (std::is_same<Hood, moore>::value or accepts<Hood>(candidates, d, R, 0, delta)))
+						out[count++] = offset;
+					return;
+				}
+
+				offset_t stride = 1;
+				for (unsigned i = d + 1; i < extent.size(); ++i)
+					stride *= extent[i];
 
-			for (auto&& pair : M)
-				ret[pair.first] = std::move(pair.second);
+				const offset_t X = extent[d], width = 2 * R + 1;
+				const offset_t c = kind_coordinate(hood_type / power(width, (unsigned)extent.size() - 1 - d) % width, X, R);
 
-			return ret;
-		}
+				offset_t ranges[3][2] = { { 1, 0 }, { -R < -c ? -c : -R, R < X - 1 - c ? R : X - 1 - c }, { 1, 0 } };
+				if (wrap and X <= width) {
+					ranges[1][0] = -c;
+					ranges[1][1] = X - 1 - c;
+				}
+				else if (wrap) {
+					ranges[0][0] = -c;
+					ranges[0][1] = R - X;
+					ranges[2][0] = X - R;
+					ranges[2][1] = X - 1 - c;
+				}
 
+				for (auto& range : ranges)
+					for (offset_t delta = range[0]; delta <= range[1]; ++delta) {
+						if (not std::is_same<Hood, moore>::value) {
+							candidates[d] = 0;
+							for (offset_t l = -R; l <= R; ++l)
+								if (wrap ? (l - delta) % X == 0 : l == delta)
+									candidates[d] |= std::uint64_t(1) << (l + R);
+						}
+						make_neighborhood<Hood>(extent, d + 1, R, wrap, hood_type, offset + delta * stride, out, count, candidates);
+					}
+			}
 
+			// Writes the sorted offsets of the neighborhood of the given type into 'out' and returns
+			// their count. Dimension d contributes (2R+1)^(D-1-d) to the type, d = 0 being the outermost.
+			template <class Hood = moore, typename Extents, typename Offsets>
+			constexpr std::size_t make_neighborhood(const Extents& extent, unsigned R, bool wrap, std::size_t hood_type, Offsets& out)
+			{
+				for (unsigned d = 0; d < extent.size(); ++d)
+					if (kind_coordinate(hood_type / power(2 * R + 1, (unsigned)extent.size() - 1 - d) % (2 * R + 1), extent[d], R) < 0)
+						return 0;
+
+				std::uint64_t candidates[max_policy_dimension]{};
+				std::size_t count = 0;
+				make_neighborhood<Hood>(extent, 0, R, wrap, hood_type, 0, out, count, candidates);
+				return count;
+			}
+		} // namespace detail
 
 		template <bool wrap, unsigned R, unsigned... XX>
-		class iterable_offsets : public iterable_space<wrap, R, XX...>
+		constexpr auto make_neighborhoods() { return make_neighborhoods<moore, wrap, R, XX...>(); }
+
+		template <class Hood, bool wrap, unsigned R, unsigned... XX>
+		constexpr auto make_neighborhoods()
+		{
+			static_assert(std::is_same<Hood, moore>::value or (2 * R + 1 <= 64 and sizeof...(XX) <= detail::max_policy_dimension),
+				"neighborhood policies support R < 32 and up to 64 dimensions");
+			constexpr std::size_t N = detail::power(2 * R + 1, sizeof...(XX));
+			constexpr std::array<unsigned, sizeof...(XX)> extent{ { XX... } };
+
+			std::array<neighborhood<N>, N> all{};
+			for (std::size_t typ = 0; typ < N; ++typ)
+				all[typ].count = detail::make_neighborhood<Hood>(extent, R, wrap, typ, all[typ].offsets);
+
+			return all;
+		}
+
+
+
+		template <class Hood, bool wrap, unsigned R, unsigned... XX>
+		class basic_iterable_offsets : public iterable_space<wrap, R, XX...>
 		{
 
 		public:
 			typedef hyper::location_iterator<R, XX...> iterator;
+			typedef hyper::neighborhood<detail::power(2 * R + 1, sizeof...(XX))> neighborhood;
+			typedef Hood policy;
+			typedef basic_iterable_offsets<moore, wrap, R, XX...> moore_offsets; // a superset of any policy's neighbors
 
-			static inline const std::vector<offset_t>& neighbors_offsets(unsigned hood_type)
-			{
-				static std::vector<std::vector<offset_t>> all_offsets = make_neighborhoods<wrap, R, XX...>();
+			static constexpr unsigned radius = R;
+			static constexpr bool wrapped = wrap;
+
+			// (2R+1)^D neighborhood types of (2R+1)^D offsets at most, computed at compile time
+			static constexpr std::array<neighborhood, detail::power(2 * R + 1, sizeof...(XX))> all_offsets
+				= make_neighborhoods<Hood, wrap, R, XX...>();
 
+			static inline constexpr const neighborhood& neighbors_offsets(unsigned hood_type)
+			{
 				assert(hood_type < all_offsets.size());
 				return all_offsets[hood_type];
 			}
-			static std::vector<const std::vector<offset_t>*> offsets()
+			static std::vector<const neighborhood*> offsets()
 			{
 				using base = iterable_space<wrap, R, XX...>;
-				std::vector<const std::vector<offset_t>*> ofs(base::size());
+				std::vector<const neighborhood*> ofs(base::size());
 
 				for (auto loc = base::begin(); loc != base::end(); ++loc)
 					ofs[(position_t)loc] = &neighbors_offsets(loc.type());
@@ -412,6 +573,9 @@ namespace sprogar
 			}
 		};
 
+		template <bool wrap, unsigned R, unsigned... XX>
+		using iterable_offsets = basic_iterable_offsets<moore, wrap, R, XX...>;
+
 		template <unsigned R, unsigned... XX>
 		using wrapped_space_offsets = iterable_offsets<true, R, XX...>;
 
@@ -423,56 +587,257 @@ namespace sprogar
 
 
 
-		template <typename T, unsigned R, bool wrap, unsigned... XX>
-		class grid
+		// Range over the neighbors of a cell, given by an iterator to the cell (anything with
+		// operator[](offset_t)) and the cell's neighborhood offsets. The offsets are referenced, unless
+		// owning, when the view keeps a copy of offsets computed per cell and is safe on temporaries.
+		template <typename CellIterator, typename Offsets, bool owning = false>
+		class neighbor_view
 		{
-			std::vector<T> data; // std::array<> is not moveable
+			typedef typename std::conditional<owning, Offsets, const Offsets*>::type holder;
+
+			CellIterator cell;
+			holder hood;
+
+			static inline holder hold(const Offsets& offsets)
+			{
+				if constexpr (owning)
+					return offsets;
+				else
+					return &offsets;
+			}
+			inline const Offsets& offsets() const
+			{
+				if constexpr (owning)
+					return hood;
+				else
+					return *hood;
+			}
 
 		public:
-			typedef iterable_offsets<wrap, R, XX...> space_offsets;
+			typedef decltype(std::declval<const CellIterator&>()[offset_t()]) reference;
 
 			class iterator {
+				CellIterator cell;
+				const offset_t* off;
+
 			public:
+				using reference = typename neighbor_view::reference;
 				using difference_type = std::ptrdiff_t;
+				using value_type = typename std::decay<reference>::type;
+				using pointer = void;
+				using iterator_category = std::forward_iterator_tag;
+
+				iterator(const CellIterator& c, const offset_t* o)
+					: cell(c)
+					, off(o)
+				{
+				}
+				inline reference operator*() const { return cell[*off]; }
+				inline iterator& operator++()
+				{
+					++off;
+					return *this;
+				}
+				inline bool operator!=(const iterator& rhs) const { return off != rhs.off; }
+				inline bool operator==(const iterator& rhs) const { return off == rhs.off; }
+			};
+
+			neighbor_view(const CellIterator& c, const Offsets& offsets)
+				: cell(c)
+				, hood(hold(offsets))
+			{
+			}
+
+			inline iterator begin() const { return iterator(cell, offsets().begin()); }
+			inline iterator end() const { return iterator(cell, offsets().end()); }
+			inline position_t size() const { return offsets().size(); }
+
+			// the sum of the neighbors (their count for bool cells)
+			inline auto sum() const
+			{
+				typedef typename std::decay<reference>::type value_type;
+				decltype(value_type() + value_type()) total{};
+				for (offset_t off : offsets())
+					total += cell[off];
+				return total;
+			}
+			// the number of neighbors satisfying pred
+			template <typename Predicate>
+			inline position_t count_if(Predicate pred) const
+			{
+				position_t count = 0;
+				for (offset_t off : offsets())
+					count += pred(cell[off]) ? 1 : 0;
+				return count;
+			}
+		};
+
+		// one term of a weighted stencil: the cell at the relative coordinates delta (outermost first) times weight
+		template <typename W, std::size_t D>
+		struct stencil_tap
+		{
+			std::array<int, D> delta;
+			W weight;
+		};
+
+		namespace detail
+		{
+			// Writes sum(weight * src[cell + delta]) over the kernel's taps into every cell of dst; taps
+			// outside an unwrapped space are left out. Rows that all taps reach without crossing a border
+			// are accumulated one tap at a time over contiguous cells, which the compiler vectorizes.
+			template <bool wrap, std::size_t D, typename Storage, typename Kernel>
+			void apply_stencil(const std::array<unsigned, D>& extent, const Storage& src, Storage& dst, const Kernel& kernel)
+			{
+				typedef typename Storage::value_type T;
+				typedef typename std::decay<decltype(std::begin(kernel)->weight)>::type W;
+				typedef decltype(std::declval<W>() * std::declval<T>()) A;
+				static_assert(std::tuple_size<typename std::decay<decltype(std::begin(kernel)->delta)>::type>::value == D,
+					"the taps of the kernel must have one coordinate per dimension of the space");
+
+				position_t size = 1;
+				std::array<position_t, D> stride;
+				for (std::size_t d = D; d-- > 0;) {
+					stride[d] = size;
+					size *= extent[d];
+				}
+				if (size == 0)
+					return;
+
+				std::array<offset_t, D> reach{}; // of the kernel in each dimension
+				std::vector<offset_t> offsets;
+				std::vector<W> weights;
+				for (const auto& tap : kernel) {
+					offset_t off = 0;
+					for (std::size_t d = 0; d < D; ++d) {
+						reach[d] = std::max<offset_t>(reach[d], tap.delta[d] < 0 ? -tap.delta[d] : tap.delta[d]);
+						off += tap.delta[d] * (offset_t)stride[d];
+					}
+					offsets.push_back(off);
+					weights.push_back(tap.weight);
+				}
+
+				std::array<offset_t, D> c{};
+				auto evaluate = [&](position_t pos) {
+					A sum{};
+					for (const auto& tap : kernel) {
+						position_t at = 0;
+						bool inside = true;
+						for (std::size_t d = 0; d < D and inside; ++d) {
+							const offset_t X = extent[d];
+							offset_t n = c[d] + tap.delta[d];
+							if (n < 0 or n >= X) {
+								inside = wrap;
+								n = (n % X + X) % X;
+							}
+							at += n * stride[d];
+						}
+						if (inside)
+							sum += tap.weight * src[at];
+					}
+					dst[pos] = static_cast<T>(sum);
+				};
+
+				const offset_t X0 = extent[D - 1], r0 = reach[D - 1];
+				std::vector<A> acc(X0);
+				for (position_t first = 0; first < size; first += X0) {
+					bool interior = X0 > 2 * r0;
+					for (std::size_t d = 0; d + 1 < D; ++d)
+						interior = interior and c[d] >= reach[d] and c[d] + reach[d] < (offset_t)extent[d];
+
+					const offset_t from = interior ? r0 : X0;
+					for (c[D - 1] = 0; c[D - 1] < from; ++c[D - 1])
+						evaluate(first + c[D - 1]);
+					if (interior) {
+						const offset_t n = X0 - 2 * r0;
+						std::fill(acc.begin(), acc.begin() + n, A{});
+						for (std::size_t k = 0; k < offsets.size(); ++k) {
+							const W w = weights[k];
+							A* out = acc.data();
+							if constexpr (std::is_same<typename Storage::reference, T&>::value) {
+								const T* in = &src[0] + first + r0 + offsets[k];
+								for (offset_t x = 0; x < n; ++x)
+									out[x] += w * in[x];
+							}
+							else
+								for (offset_t x = 0; x < n; ++x)
+									out[x] += w * src[first + r0 + offsets[k] + x];
+						}
+						for (offset_t x = 0; x < n; ++x)
+							dst[first + r0 + x] = static_cast<T>(acc[x]);
+						for (c[D - 1] = X0 - r0; c[D - 1] < X0; ++c[D - 1])
+							evaluate(first + c[D - 1]);
+					}
+
+					for (std::size_t d = D - 1; d-- > 0;) {
+						if (++c[d] < (offset_t)extent[d])
+							break;
+						c[d] = 0;
+					}
+				}
+			}
+		} // namespace detail
+
+		// Grid over any random-access Storage of cells with value_type, (const_)reference, (const_)pointer,
+		// construction by (size) and (size, value), size(), operator[], swap() and ==. The neighbors of
+		// the cells are selected by the Hood policy.
+		template <typename Storage, class Hood, unsigned R, bool wrap, unsigned... XX>
+		class basic_grid
+		{
+			typedef typename Storage::value_type T;
+
+			Storage data; // std::array<> is not moveable
+
+		public:
+			typedef basic_iterable_offsets<Hood, wrap, R, XX...> space_offsets;
+			typedef Storage storage_type;
+			typedef T value_type;
+			typedef typename Storage::reference reference;
+			typedef typename Storage::const_reference const_reference;
+
+			class iterator {
+			public:
+				using difference_type = offset_t;
 				using value_type = T;
-				using pointer = T*;
-				using reference = T&;
-				using iterator_category = std::bidirectional_iterator_tag;
+				using pointer = typename Storage::pointer;
+				using reference = typename Storage::reference;
+				using iterator_category = std::random_access_iterator_tag;
 
-				std::vector<T>& _data;
+				Storage* _data;
 				location_iterator<R, XX...> _loc;
 
-				iterator(std::vector<T>& d, const location_iterator<R, XX...>& loc)
-					: _data(d)
+				iterator()
+					: _data(nullptr)
+				{
+				}
+				iterator(Storage& d, const location_iterator<R, XX...>& loc)
+					: _data(&d)
 					, _loc(loc)
 				{
 				}
 
-				inline operator unsigned() const { return (unsigned)_loc; }
-				inline typename std::vector<T>::reference operator*() { return _data[_loc]; }
-				inline typename std::vector<T>::pointer operator->() { return &_data[_loc]; }
+				inline operator position_t() const { return _loc; }
+				inline typename Storage::reference operator*() const { return (*_data)[_loc]; }
+				inline typename Storage::pointer operator->() const { return &(*_data)[_loc]; }
 
-				inline std::vector<offset_t>::const_iterator begin() const
+				inline const offset_t* begin() const
 				{
 					return space_offsets::neighbors_offsets(_loc.type()).begin();
 				}
-				inline std::vector<offset_t>::const_iterator end() const
+				inline const offset_t* end() const
 				{
 					return space_offsets::neighbors_offsets(_loc.type()).end();
 				}
 				inline position_t size() const { return space_offsets::neighbors_offsets(_loc.type()).size(); }
 				inline unsigned type() const { return _loc.type(); }
 
-				inline const std::vector<offset_t>& neighbors_offsets() const
+				inline const typename space_offsets::neighborhood& neighbors_offsets() const
 				{
 					return space_offsets::neighbors_offsets(_loc.type());
 				}
-				inline std::vector<std::reference_wrapper<T>> neighbors() const
+				// the neighboring cells, without allocation
+				inline neighbor_view<iterator, typename space_offsets::neighborhood> neighbors() const
 				{
-					std::vector<std::reference_wrapper<T>> ans;
-					for (offset_t off : space_offsets::neighbors_offsets(_loc.type()))
-						ans.push_back(std::ref(_data[_loc + off]));
-					return ans;
+					return neighbor_view<iterator, typename space_offsets::neighborhood>(*this, neighbors_offsets());
 				}
 
 				inline iterator& operator++()
@@ -485,47 +850,94 @@ namespace sprogar
 					--_loc;
 					return *this;
 				}
+				inline iterator operator++(int)
+				{
+					iterator old = *this;
+					++_loc;
+					return old;
+				}
+				inline iterator operator--(int)
+				{
+					iterator old = *this;
+					--_loc;
+					return old;
+				}
+				// jumps in O(D)
+				template <typename N, detail::if_integral<N> = 0>
+				inline iterator& operator+=(N n)
+				{
+					_loc += (offset_t)n;
+					return *this;
+				}
+				template <typename N, detail::if_integral<N> = 0>
+				inline iterator& operator-=(N n) { return *this += -(offset_t)n; }
+				template <typename N, detail::if_integral<N> = 0>
+				inline iterator operator+(N n) const { return iterator(*this) += n; }
+				template <typename N, detail::if_integral<N> = 0>
+				inline iterator operator-(N n) const { return iterator(*this) -= n; }
+				template <typename N, detail::if_integral<N> = 0>
+				friend inline iterator operator+(N n, const iterator& it) { return it + n; }
+				inline offset_t operator-(const iterator& rhs) const { return (offset_t)(position_t)_loc - (offset_t)(position_t)rhs._loc; }
+
 				inline bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
 				inline bool operator==(const iterator& rhs) const { return _loc == rhs._loc; }
-				inline typename std::vector<T>::reference operator[](offset_t offset) { return _data[_loc + offset]; }
+				inline bool operator<(const iterator& rhs) const { return (position_t)_loc < (position_t)rhs._loc; }
+				inline bool operator>(const iterator& rhs) const { return rhs < *this; }
+				inline bool operator<=(const iterator& rhs) const { return !(rhs < *this); }
+				inline bool operator>=(const iterator& rhs) const { return !(*this < rhs); }
+				// the cell at the offset, also a neighbor's
+				inline typename Storage::reference operator[](offset_t offset) const { return (*_data)[_loc + offset]; }
 				inline unsigned coordinate(unsigned c) const { return _loc[c]; }
 			};
 
 			struct const_iterator {
-				using difference_type = std::ptrdiff_t;
+				using difference_type = offset_t;
 				using value_type = T;
-				using pointer = T*;
-				using reference = T&;
-				using iterator_category = std::bidirectional_iterator_tag;
+				using pointer = typename Storage::const_pointer;
+				using reference = typename Storage::const_reference;
+				using iterator_category = std::random_access_iterator_tag;
 
-				const std::vector<T>& _data;
+				const Storage* _data;
 				location_iterator<R, XX...> _loc;
 
-				const_iterator(const std::vector<T>& d, const location_iterator<R, XX...>& loc)
-					: _data(d)
+				const_iterator()
+					: _data(nullptr)
+				{
+				}
+				const_iterator(const Storage& d, const location_iterator<R, XX...>& loc)
+					: _data(&d)
 					, _loc(loc)
 				{
 				}
+				const_iterator(const iterator& it)
+					: _data(it._data)
+					, _loc(it._loc)
+				{
+				}
 
-				inline operator unsigned() const { return (unsigned)_loc; }
-				inline typename std::vector<T>::const_reference operator*() const { return _data[_loc]; }
-				inline typename std::vector<T>::const_pointer operator->() const { return &_data[_loc]; }
+				inline operator position_t() const { return _loc; }
+				inline typename Storage::const_reference operator*() const { return (*_data)[_loc]; }
+				inline typename Storage::const_pointer operator->() const { return &(*_data)[_loc]; }
 
-				inline std::vector<offset_t>::const_iterator begin() const
+				inline const offset_t* begin() const
 				{
 					return space_offsets::neighbors_offsets(_loc.type()).begin();
 				}
-				inline std::vector<offset_t>::const_iterator end() const
+				inline const offset_t* end() const
 				{
 					return space_offsets::neighbors_offsets(_loc.type()).end();
 				}
 				inline position_t size() const { return space_offsets::neighbors_offsets(_loc.type()).size(); }
 				inline unsigned type() const { return _loc.type(); }
 
-				inline const std::vector<offset_t>& neighbors_offsets() const
+				inline const typename space_offsets::neighborhood& neighbors_offsets() const
 				{
 					return space_offsets::neighbors_offsets(_loc.type());
 				}
+				inline neighbor_view<const_iterator, typename space_offsets::neighborhood> neighbors() const
+				{
+					return neighbor_view<const_iterator, typename space_offsets::neighborhood>(*this, neighbors_offsets());
+				}
 
 				inline const_iterator& operator++()
 				{
@@ -537,36 +949,78 @@ namespace sprogar
 					--_loc;
 					return *this;
 				}
+				inline const_iterator operator++(int)
+				{
+					const_iterator old = *this;
+					++_loc;
+					return old;
+				}
+				inline const_iterator operator--(int)
+				{
+					const_iterator old = *this;
+					--_loc;
+					return old;
+				}
+				template <typename N, detail::if_integral<N> = 0>
+				inline const_iterator& operator+=(N n)
+				{
+					_loc += (offset_t)n;
+					return *this;
+				}
+				template <typename N, detail::if_integral<N> = 0>
+				inline const_iterator& operator-=(N n) { return *this += -(offset_t)n; }
+				template <typename N, detail::if_integral<N> = 0>
+				inline const_iterator operator+(N n) const { return const_iterator(*this) += n; }
+				template <typename N, detail::if_integral<N> = 0>
+				inline const_iterator operator-(N n) const { return const_iterator(*this) -= n; }
+				template <typename N, detail::if_integral<N> = 0>
+				friend inline const_iterator operator+(N n, const const_iterator& it) { return it + n; }
+				inline offset_t operator-(const const_iterator& rhs) const { return (offset_t)(position_t)_loc - (offset_t)(position_t)rhs._loc; }
+
 				inline bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
 				inline bool operator==(const const_iterator& rhs) const { return _loc == rhs._loc; }
-				inline typename std::vector<T>::const_reference operator[](offset_t offset) const
+				inline bool operator<(const const_iterator& rhs) const { return (position_t)_loc < (position_t)rhs._loc; }
+				inline bool operator>(const const_iterator& rhs) const { return rhs < *this; }
+				inline bool operator<=(const const_iterator& rhs) const { return !(rhs < *this); }
+				inline bool operator>=(const const_iterator& rhs) const { return !(*this < rhs); }
+				inline typename Storage::const_reference operator[](offset_t offset) const
 				{
-					return _data[_loc + offset];
+					return (*_data)[_loc + offset];
 				}
 				inline unsigned coordinate(unsigned c) const { return _loc[c]; }
 			};
 
 		public:
-			grid()
+			basic_grid()
 				: data(space_offsets::size())
 			{
 			}
-			grid(T _default)
+			basic_grid(T _default)
 				: data(space_offsets::size(), _default)
 			{
 			}
-			grid(T(*f)())
+			basic_grid(T(*f)())
+				: data(detail::generate<Storage>(space_offsets::size(), f, 0))
 			{
-				data.reserve(space_offsets::size());
-				while (data.size() < space_offsets::size())
-					data.push_back(f());
+			}
+			// cells from the given allocator of the storage, or whatever the allocator is made from
+			template <typename Allocator>
+			basic_grid(T _default, Allocator&& allocator)
+				: data(space_offsets::size(), _default, typename Storage::allocator_type(std::forward<Allocator>(allocator)))
+			{
+			}
+			// adopts the cells of the given storage
+			explicit basic_grid(Storage storage)
+				: data(std::move(storage))
+			{
+				assert(data.size() == space_offsets::size());
 			}
 
 
 			static inline constexpr std::string info() { return space_offsets::info(); }
 
-			inline typename std::vector<T>::reference operator[](position_t pos) { return data[pos]; }
-			inline typename std::vector<T>::const_reference operator[](position_t pos) const { return data[pos]; }
+			inline typename Storage::reference operator[](position_t pos) { return data[pos]; }
+			inline typename Storage::const_reference operator[](position_t pos) const { return data[pos]; }
 
 			inline static constexpr position_t size() { return space_offsets::size(); }
 
@@ -593,42 +1047,900 @@ namespace sprogar
 				static_assert(sizeof...(CC) == sizeof...(XX));
 				return const_iterator(data, location_iterator<R, XX...>(cc...));
 			}
-			inline static const std::vector<offset_t>& neighbors_offsets(const location_iterator<R, XX...>& it)
+			inline static const typename space_offsets::neighborhood& neighbors_offsets(const location_iterator<R, XX...>& it)
 			{
 				return space_offsets::neighbors_offsets(it.type());
 			}
-			inline static const std::vector<offset_t>& neighbors_offsets(unsigned nhood_type)
+			inline static const typename space_offsets::neighborhood& neighbors_offsets(unsigned nhood_type)
 			{
 				return space_offsets::neighbors_offsets(nhood_type);
 			}
 
+			// Writes sum(weight * src[cell + delta]) over the kernel's stencil_tap<W, D>s into every cell of dst,
+			// wrapping the taps around the borders of a wrapped space and leaving them out otherwise.
+			// The kernel may be a (constexpr) std::array or a std::vector of taps, of any radius.
+			template <typename Kernel>
+			static void apply_stencil(const basic_grid& src, basic_grid& dst, const Kernel& kernel)
+			{
+				assert(&src != &dst);
+				detail::apply_stencil<wrap>(extent, src.data, dst.data, kernel);
+			}
+
+			// Calls f(iterator, offsets) for every cell at least R cells away from all borders;
+			// such cells share the interior neighborhood (type 0), so no types are computed.
+			template <typename F>
+			inline void for_each_interior(F f) { visit_interior<iterator>(data, f); }
+			template <typename F>
+			inline void for_each_interior(F f) const { visit_interior<const_iterator>(data, f); }
+
+			// Calls f(iterator, offsets) for the remaining cells, i.e. those within R of any border.
+			template <typename F>
+			inline void for_each_boundary(F f) { visit_boundary<iterator>(data, f); }
+			template <typename F>
+			inline void for_each_boundary(F f) const { visit_boundary<const_iterator>(data, f); }
+
 			template <typename... CC>
-			inline typename std::vector<T>::reference operator()(CC... cc)
+			inline typename Storage::reference operator()(CC... cc)
 			{
 				static_assert(sizeof...(CC) == sizeof...(XX));
 				// return data[typename space_offsets::iterator(cc...)];
 				return data[(position_t)location_iterator<R, XX...>(cc...)];
 			}
 			template <typename... CC>
-			inline typename std::vector<T>::const_reference operator()(CC... cc) const
+			inline typename Storage::const_reference operator()(CC... cc) const
 			{
 				static_assert(sizeof...(CC) == sizeof...(XX));
 				// return data[typename space_offsets::iterator(cc...)];
 				return data[(position_t)location_iterator<R, XX...>(cc...)];
 			}
 
-			friend void swap(grid& lhs, grid& rhs) noexcept { lhs.data.swap(rhs.data); }
+			inline Storage& storage() { return data; }
+			inline const Storage& storage() const { return data; }
+
+			friend void swap(basic_grid& lhs, basic_grid& rhs) noexcept { lhs.data.swap(rhs.data); }
+
+			inline bool operator!=(const basic_grid& oth) const { return !(*this == oth); }
+			inline bool operator==(const basic_grid& oth) const { return data == oth.data; }
 
-			inline bool operator!=(const grid& oth) const { return !(*this == oth); }
-			inline bool operator==(const grid& oth) const { return data == oth.data; }
+		private:
+			static constexpr std::array<unsigned, sizeof...(XX)> extent{ { XX... } };
+
+			// calls visit(first, interior) for each row of the innermost dimension, where 'first' is
+			// the position of the row's first cell and 'interior' tells whether all outer coordinates are interior
+			template <typename Visit>
+			static void for_each_row(Visit visit)
+			{
+				constexpr unsigned D = sizeof...(XX);
+				constexpr position_t X0 = extent[D - 1];
+				std::array<unsigned, D> c{};
+
+				for (position_t first = 0; first < size(); first += X0) {
+					bool interior = true;
+					for (unsigned d = 0; d + 1 < D; ++d)
+						interior = interior and c[d] >= R and c[d] + R < extent[d];
+
+					visit(first, interior);
+
+					for (unsigned d = D - 1; d-- > 0;) {
+						if (++c[d] < extent[d])
+							break;
+						c[d] = 0;
+					}
+				}
+			}
+			template <typename Iterator, typename Data, typename F>
+			static void visit_interior(Data& data, F& f)
+			{
+				constexpr position_t X0 = extent[sizeof...(XX) - 1];
+				const auto& hood = space_offsets::neighbors_offsets(0);
+
+				for_each_row([&](position_t first, bool interior) {
+					if (not interior)
+						return;
+					Iterator it(data, location_iterator<R, XX...>(first + R));
+					for (position_t x = R; x + R < X0; ++x, ++it)
+						f(it, hood);
+				});
+			}
+			template <typename Iterator, typename Data, typename F>
+			static void visit_boundary(Data& data, F& f)
+			{
+				constexpr position_t X0 = extent[sizeof...(XX) - 1];
+
+				for_each_row([&](position_t first, bool interior) {
+					auto visit = [&](position_t from, position_t to) {
+						Iterator it(data, location_iterator<R, XX...>(first + from));
+						for (position_t x = from; x < to; ++x, ++it)
+							f(it, space_offsets::neighbors_offsets(it.type()));
+					};
+					if (interior and X0 >= 2 * R + 1) {
+						visit(0, R);
+						visit(X0 - R, X0);
+					}
+					else
+						visit(0, X0);
+				});
+			}
 		};
 
+		template <typename T, unsigned R, bool wrap, unsigned... XX>
+		using grid = basic_grid<std::vector<T>, moore, R, wrap, XX...>;
+
+		// grid with the neighbors selected by the Hood policy, e.g. von_neumann
+		template <typename T, class Hood, unsigned R, bool wrap, unsigned... XX>
+		using neighborhood_grid = basic_grid<std::vector<T>, Hood, R, wrap, XX...>;
+
 		template <typename T, unsigned Radius, unsigned... XX>
 		using wrapped_space = grid<T, Radius, true, XX...>;
 
 		template <typename T, unsigned Radius, unsigned... XX>
 		using unwrapped_space = grid<T, Radius, false, XX...>;
 
+
+
+		// Boolean grid storing 64 cells per word along the innermost dimension; every row starts a new word.
+		template <unsigned R, bool wrap, unsigned... XX>
+		class bit_grid
+		{
+			static_assert(sizeof...(XX) > 0, "bit_grid needs at least one dimension");
+
+		public:
+			typedef iterable_offsets<wrap, R, XX...> space_offsets;
+			typedef std::uint64_t word;
+			typedef bool value_type;
+			typedef bool const_reference;
+
+			static constexpr unsigned word_bits = 64;
+
+		private:
+			static constexpr std::array<unsigned, sizeof...(XX)> extent{ { XX... } };
+			static constexpr position_t X0 = extent[sizeof...(XX) - 1];
+			static constexpr position_t words_per_row = (X0 + word_bits - 1) / word_bits;
+			static constexpr word last_word_mask = X0 % word_bits ? (word(1) << X0 % word_bits) - 1 : ~word(0);
+
+			std::vector<word> bits;
+
+			static inline position_t word_index(position_t pos) { return pos / X0 * words_per_row + pos % X0 / word_bits; }
+			static inline word bit_mask(position_t pos) { return word(1) << (pos % X0 % word_bits); }
+
+		public:
+			class reference
+			{
+				word* _word;
+				word _mask;
+
+			public:
+				reference(word* w, word mask)
+					: _word(w)
+					, _mask(mask)
+				{
+				}
+				inline operator bool() const { return (*_word & _mask) != 0; }
+				inline reference& operator=(bool value)
+				{
+					if (value)
+						*_word |= _mask;
+					else
+						*_word &= ~_mask;
+					return *this;
+				}
+				inline reference& operator=(const reference& other) { return *this = bool(other); }
+			};
+
+			class iterator {
+			public:
+				using difference_type = std::ptrdiff_t;
+				using value_type = bool;
+				using pointer = void;
+				using reference = typename bit_grid::reference;
+				using iterator_category = std::bidirectional_iterator_tag;
+
+				bit_grid* _grid;
+				location_iterator<R, XX...> _loc;
+
+				iterator(bit_grid& g, const location_iterator<R, XX...>& loc)
+					: _grid(&g)
+					, _loc(loc)
+				{
+				}
+
+				inline operator position_t() const { return _loc; }
+				inline reference operator*() const { return (*_grid)[_loc]; }
+
+				inline const offset_t* begin() const { return space_offsets::neighbors_offsets(_loc.type()).begin(); }
+				inline const offset_t* end() const { return space_offsets::neighbors_offsets(_loc.type()).end(); }
+				inline position_t size() const { return space_offsets::neighbors_offsets(_loc.type()).size(); }
+				inline unsigned type() const { return _loc.type(); }
+
+				inline const typename space_offsets::neighborhood& neighbors_offsets() const
+				{
+					return space_offsets::neighbors_offsets(_loc.type());
+				}
+
+				inline iterator& operator++()
+				{
+					++_loc;
+					return *this;
+				}
+				inline iterator& operator--()
+				{
+					--_loc;
+					return *this;
+				}
+				inline bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+				inline bool operator==(const iterator& rhs) const { return _loc == rhs._loc; }
+				inline reference operator[](offset_t offset) const { return (*_grid)[_loc + offset]; }
+				inline unsigned coordinate(unsigned c) const { return _loc[c]; }
+			};
+
+			class const_iterator {
+			public:
+				using difference_type = std::ptrdiff_t;
+				using value_type = bool;
+				using pointer = void;
+				using reference = bool;
+				using iterator_category = std::bidirectional_iterator_tag;
+
+				const bit_grid* _grid;
+				location_iterator<R, XX...> _loc;
+
+				const_iterator(const bit_grid& g, const location_iterator<R, XX...>& loc)
+					: _grid(&g)
+					, _loc(loc)
+				{
+				}
+
+				inline operator position_t() const { return _loc; }
+				inline bool operator*() const { return (*_grid)[_loc]; }
+
+				inline const offset_t* begin() const { return space_offsets::neighbors_offsets(_loc.type()).begin(); }
+				inline const offset_t* end() const { return space_offsets::neighbors_offsets(_loc.type()).end(); }
+				inline position_t size() const { return space_offsets::neighbors_offsets(_loc.type()).size(); }
+				inline unsigned type() const { return _loc.type(); }
+
+				inline const typename space_offsets::neighborhood& neighbors_offsets() const
+				{
+					return space_offsets::neighbors_offsets(_loc.type());
+				}
+
+				inline const_iterator& operator++()
+				{
+					++_loc;
+					return *this;
+				}
+				inline const_iterator& operator--()
+				{
+					--_loc;
+					return *this;
+				}
+				inline bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+				inline bool operator==(const const_iterator& rhs) const { return _loc == rhs._loc; }
+				inline bool operator[](offset_t offset) const { return (*_grid)[_loc + offset]; }
+				inline unsigned coordinate(unsigned c) const { return _loc[c]; }
+			};
+
+		public:
+			bit_grid()
+				: bits(size() / X0 * words_per_row)
+			{
+			}
+			bit_grid(bool _default)
+				: bits(size() / X0 * words_per_row, _default ? ~word(0) : 0)
+			{
+				for (position_t w = words_per_row - 1; w < bits.size(); w += words_per_row)
+					bits[w] &= last_word_mask;
+			}
+			bit_grid(bool(*f)())
+				: bit_grid()
+			{
+				for (position_t pos = 0; pos < size(); ++pos)
+					(*this)[pos] = f();
+			}
+
+			static inline std::string info() { return space_offsets::info() + " bits"; }
+
+			inline reference operator[](position_t pos) { return reference(&bits[word_index(pos)], bit_mask(pos)); }
+			inline bool operator[](position_t pos) const { return (bits[word_index(pos)] & bit_mask(pos)) != 0; }
+
+			inline static constexpr position_t size() { return space_offsets::size(); }
+
+			inline static constexpr position_t dimension() { return sizeof...(XX); }
+			inline static constexpr position_t dimension(unsigned D) { return space_offsets::dimension(D); }
+
+			// the packed rows; the unused bits of every row's last word are always 0
+			inline const std::vector<word>& words() const { return bits; }
+
+			inline iterator begin() { return iterator(*this, space_offsets::begin()); }
+			inline iterator end() { return iterator(*this, space_offsets::end()); }
+			inline const_iterator begin() const { return const_iterator(*this, space_offsets::begin()); }
+			inline const_iterator end() const { return const_iterator(*this, space_offsets::end()); }
+
+			template <typename... CC>
+			inline iterator at(CC... cc)
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return iterator(*this, location_iterator<R, XX...>(cc...));
+			}
+			template <typename... CC>
+			inline const_iterator at(CC... cc) const
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return const_iterator(*this, location_iterator<R, XX...>(cc...));
+			}
+			inline static const typename space_offsets::neighborhood& neighbors_offsets(unsigned nhood_type)
+			{
+				return space_offsets::neighbors_offsets(nhood_type);
+			}
+
+			template <typename... CC>
+			inline reference operator()(CC... cc)
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return (*this)[(position_t)location_iterator<R, XX...>(cc...)];
+			}
+			template <typename... CC>
+			inline bool operator()(CC... cc) const
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return (*this)[(position_t)location_iterator<R, XX...>(cc...)];
+			}
+
+			// Computes next = rule(count, alive) for all cells at once for a whole word, where count is the number
+			// of living cells in the cell's Moore neighborhood. The neighbors' words are shifted into place and
+			// summed by a bit-sliced counter, whose bit planes then select the cells for which the rule holds.
+			template <typename Rule>
+			void step(bit_grid& next, Rule rule) const
+			{
+				static_assert(R == 1, "the bit-parallel kernel supports Moore neighborhoods of radius 1");
+				assert(&next != this);
+
+				constexpr unsigned D = sizeof...(XX);
+				constexpr unsigned max_count = (unsigned)detail::power(3, D) - 1;
+				constexpr unsigned planes = [] {
+					unsigned n = 0;
+					while ((max_count >> n) != 0)
+						n += 1;
+					return n;
+				}();
+				// a dimension of size 1 (or 2 when wrapped) lacks distinct left and right neighbors
+				constexpr bool west = X0 >= 2, east = X0 >= 3 or (X0 == 2 and not wrap);
+
+				std::array<bool, max_count + 1> born{}, survives{};
+				for (unsigned n = 0; n <= max_count; ++n) {
+					born[n] = rule((int)n, false);
+					survives[n] = rule((int)n, true);
+				}
+
+				std::array<unsigned, D> c{}; // outer coordinates of the current row
+				std::array<position_t, detail::power(3, D - 1)> rows{};
+
+				for (position_t row = 0; row < size() / X0; ++row) {
+					// the distinct neighboring rows (including this one), as products of the outer dimensions' neighbors
+					unsigned count = 1;
+					rows[0] = 0;
+					position_t stride = 1;
+					for (unsigned d = D - 1; d-- > 0;) {
+						const offset_t X = extent[d];
+						offset_t targets[3] = { (offset_t)c[d], 0, 0 };
+						unsigned n = 1;
+						for (offset_t delta : { -1, 1 }) {
+							offset_t t = (offset_t)c[d] + delta;
+							if (t < 0 or t >= X) {
+								if (not wrap)
+									continue;
+								t = (t + X) % X;
+							}
+							if (t != targets[0] and (n < 2 or t != targets[1]))
+								targets[n++] = t;
+						}
+						for (unsigned i = count; i-- > 0;) {
+							const position_t base = rows[i];
+							for (unsigned k = 0; k < n; ++k)
+								rows[i * n + k] = base + (position_t)targets[k] * stride;
+						}
+						count *= n;
+						stride *= X;
+					}
+
+					const word* self = &bits[row * words_per_row];
+					word* out = &next.bits[row * words_per_row];
+
+					for (position_t k = 0; k < words_per_row; ++k) {
+						std::array<word, planes> sum{};
+						auto add = [&](word x) {
+							for (unsigned b = 0; x != 0 and b < planes; ++b) {
+								const word carry = sum[b] & x;
+								sum[b] ^= x;
+								x = carry;
+							}
+						};
+						for (unsigned i = 0; i < count; ++i) {
+							const word* r = &bits[rows[i] * words_per_row];
+							const word first = r[0] & 1, last = r[words_per_row - 1] >> (X0 - 1) % word_bits & 1;
+
+							if (rows[i] != row)
+								add(r[k]);
+							if (west)
+								add(r[k] << 1 | (k > 0 ? r[k - 1] >> (word_bits - 1) : wrap ? last : 0));
+							if (east) {
+								word e = r[k] >> 1 | (k + 1 < words_per_row ? r[k + 1] << (word_bits - 1) : 0);
+								if (wrap and k + 1 == words_per_row)
+									e |= first << (X0 - 1) % word_bits;
+								add(e);
+							}
+						}
+
+						word result = 0;
+						for (unsigned n = 0; n <= max_count; ++n) {
+							const word candidates = (survives[n] ? self[k] : 0) | (born[n] ? ~self[k] : 0);
+							if (candidates == 0)
+								continue;
+							word equal = ~word(0);
+							for (unsigned b = 0; b < planes; ++b)
+								equal &= (n >> b & 1) ? sum[b] : ~sum[b];
+							result |= equal & candidates;
+						}
+						out[k] = k + 1 == words_per_row ? result & last_word_mask : result;
+					}
+
+					for (unsigned d = D - 1; d-- > 0;) {
+						if (++c[d] < extent[d])
+							break;
+						c[d] = 0;
+					}
+				}
+			}
+
+			friend void swap(bit_grid& lhs, bit_grid& rhs) noexcept { lhs.bits.swap(rhs.bits); }
+
+			inline bool operator!=(const bit_grid& oth) const { return !(*this == oth); }
+			inline bool operator==(const bit_grid& oth) const { return bits == oth.bits; }
+		};
+
+		// boundary conditions for halo_grid::fill_halo(), mapping a coordinate outside [0, X) into it
+		struct periodic
+		{
+			inline offset_t operator()(offset_t c, offset_t X) const { return (c % X + X) % X; }
+		};
+		struct reflective
+		{
+			// mirror image of the border: -1 -> 0, -2 -> 1, ..., X -> X - 1, X + 1 -> X - 2, ...
+			inline offset_t operator()(offset_t c, offset_t X) const
+			{
+				c = (c % (2 * X) + 2 * X) % (2 * X);
+				return c < X ? c : 2 * X - 1 - c;
+			}
+		};
+
+		// Grid with an R-wide halo of ghost cells around every dimension. Once the halo is refilled
+		// by fill_halo(), all real cells share the same neighborhood, so no per-cell type is needed.
+		// Iterators and positions (operator[]) refer to the padded space.
+		template <typename T, unsigned R, unsigned... XX>
+		class halo_grid
+		{
+		public:
+			typedef grid<T, R, false, (XX + 2 * R)...> padded_grid;
+			typedef typename padded_grid::iterator iterator;
+			typedef typename padded_grid::const_iterator const_iterator;
+			typedef typename padded_grid::space_offsets::neighborhood neighborhood;
+
+		private:
+			padded_grid padded;
+			static constexpr std::array<offset_t, sizeof...(XX)> extent{ { XX... } };
+
+		public:
+			halo_grid()
+			{
+			}
+			halo_grid(T _default)
+				: padded(_default)
+			{
+			}
+
+			static inline std::string info() { return iterable_space<false, R, XX...>::info() + " halo"; }
+
+			inline static constexpr position_t size() { return iterable_space<false, R, XX...>::size(); }
+			inline static constexpr position_t dimension() { return sizeof...(XX); }
+			inline static constexpr position_t dimension(unsigned D) { return iterable_space<false, R, XX...>::dimension(D); }
+
+			inline typename std::vector<T>::reference operator[](position_t pos) { return padded[pos]; }
+			inline typename std::vector<T>::const_reference operator[](position_t pos) const { return padded[pos]; }
+
+			template <typename... CC>
+			inline typename std::vector<T>::reference operator()(CC... cc) { return padded((cc + R)...); }
+			template <typename... CC>
+			inline typename std::vector<T>::const_reference operator()(CC... cc) const { return padded((cc + R)...); }
+
+			template <typename... CC>
+			inline iterator at(CC... cc) { return padded.at((cc + R)...); }
+			template <typename... CC>
+			inline const_iterator at(CC... cc) const { return padded.at((cc + R)...); }
+
+			// the neighborhood of every real cell
+			inline static const neighborhood& neighbors_offsets() { return padded_grid::neighbors_offsets(0); }
+
+			// calls f(iterator, offsets) for every real cell
+			template <typename F>
+			inline void for_each(F f) { padded.for_each_interior(f); }
+			template <typename F>
+			inline void for_each(F f) const { padded.for_each_interior(f); }
+
+			// constant boundary: the halo holds the given value
+			void fill_halo(const T& value)
+			{
+				padded.for_each_boundary([&](iterator it, const typename padded_grid::space_offsets::neighborhood&) { *it = value; });
+			}
+			// periodic, reflective or user-defined boundary: each halo cell copies the real cell
+			// obtained by mapping its outlying coordinates with boundary(c, X)
+			template <typename Boundary, detail::if_boundary<Boundary> = 0>
+			void fill_halo(Boundary boundary)
+			{
+				constexpr unsigned D = sizeof...(XX);
+
+				padded.for_each_boundary([&](iterator it, const typename padded_grid::space_offsets::neighborhood&) {
+					position_t source = 0;
+					for (unsigned d = 0; d < D; ++d) {
+						offset_t c = (offset_t)it.coordinate(D - 1 - d) - (offset_t)R;
+						if (c < 0 or c >= extent[d])
+							c = boundary(c, extent[d]);
+						source = source * (extent[d] + 2 * R) + (position_t)(c + R);
+					}
+					*it = padded[source];
+				});
+			}
+
+			friend void swap(halo_grid& lhs, halo_grid& rhs) noexcept { swap(lhs.padded, rhs.padded); }
+
+			inline bool operator!=(const halo_grid& oth) const { return !(*this == oth); }
+			inline bool operator==(const halo_grid& oth) const
+			{
+				bool equal = true;
+				for_each([&](const_iterator it, const neighborhood&) { equal = equal and *it == oth[it]; });
+				return equal;
+			}
+		};
+
+		// contiguous run of neighbor offsets
+		struct offset_range
+		{
+			const offset_t* first;
+			const offset_t* last;
+
+			inline const offset_t* begin() const { return first; }
+			inline const offset_t* end() const { return last; }
+			inline position_t size() const { return last - first; }
+			inline offset_t operator[](std::size_t i) const { return first[i]; }
+		};
+
+		// Shape of a space known only at run time: extents (outermost first), radius and wrapping,
+		// together with the offset tables of all (2R+1)^D neighborhood types, built once per shape.
+		// The tables hold up to (2R+1)^2D offsets, which limits the dimension and the radius.
+		class dynamic_space
+		{
+		public:
+			static constexpr unsigned max_dimension = 7;
+			static constexpr std::size_t max_table_offsets = std::size_t(1) << 24; // 128 MiB
+
+		private:
+			std::vector<unsigned> xx;
+			unsigned R;
+			bool wrap;
+			position_t cells;
+			std::vector<unsigned> weight; // contribution of each dimension to the neighborhood type
+			std::vector<offset_t> offsets; // the offsets of all types, one type after another
+			std::vector<position_t> first; // where the offsets of each type start
+
+		public:
+			dynamic_space(std::vector<unsigned> extents, unsigned radius, bool wrapped)
+				: xx(std::move(extents))
+				, R(radius)
+				, wrap(wrapped)
+				, cells(1)
+				, weight(xx.size())
+			{
+				if (xx.empty() or xx.size() > max_dimension)
+					throw std::invalid_argument("dynamic_space: dimension must be 1.." + std::to_string(max_dimension));
+				const unsigned D = dimension();
+				const std::size_t width = std::size_t(R) * 2 + 1;
+				std::size_t table = 1;
+				for (unsigned i = 0; i < 2 * D; ++i) {
+					if (table > max_table_offsets / width)
+						throw std::length_error("dynamic_space: radius too large for the offset tables");
+					table *= width;
+				}
+				const std::size_t N = detail::power(width, D);
+
+				for (unsigned d = 0; d < D; ++d) {
+					if (xx[d] != 0 and cells > detail::max_cells / xx[d])
+						throw std::length_error("dynamic_space: too many cells");
+					cells *= xx[d];
+					weight[d] = (unsigned)detail::power(2 * R + 1, D - 1 - d);
+				}
+
+				std::vector<offset_t> hood(N);
+				first.reserve(N + 1);
+				for (std::size_t typ = 0; typ < N; ++typ) {
+					first.push_back(offsets.size());
+					const std::size_t count = detail::make_neighborhood(xx, R, wrap, typ, hood);
+					offsets.insert(offsets.end(), hood.begin(), hood.begin() + count);
+				}
+				first.push_back(offsets.size());
+			}
+
+			inline std::string info() const
+			{
+				std::string msg;
+				for (unsigned d = 0; d < dimension(); ++d)
+					msg += std::to_string(xx[d]) + (d + 1 < dimension() ? "x" : " ");
+				return msg + (wrap ? "" : "un") + "wrapped R" + std::to_string(R);
+			}
+
+			inline position_t size() const { return cells; }
+			inline unsigned dimension() const { return (unsigned)xx.size(); }
+			// the extent of dimension D, 0 being the innermost
+			inline unsigned dimension(unsigned D) const { return xx[xx.size() - 1 - D]; }
+			// the extent of dimension d, 0 being the outermost
+			inline unsigned extent(unsigned d) const { return xx[d]; }
+			inline unsigned radius() const { return R; }
+			inline bool wrapped() const { return wrap; }
+
+			// the contribution of coordinate c of dimension d (0 being the outermost) to the neighborhood type
+			inline unsigned kind(unsigned d, unsigned c) const
+			{
+				const unsigned X = xx[d];
+				return (c < R ? 1 + c : c > X - R - 1 ? 2 * R - (X - 1 - c) : 0) * weight[d];
+			}
+
+			inline offset_range neighbors_offsets(unsigned hood_type) const
+			{
+				assert(hood_type + 1 < first.size());
+				return { offsets.data() + first[hood_type], offsets.data() + first[hood_type + 1] };
+			}
+
+			inline bool operator!=(const dynamic_space& oth) const { return !(*this == oth); }
+			inline bool operator==(const dynamic_space& oth) const { return xx == oth.xx and R == oth.R and wrap == oth.wrap; }
+		};
+
+		// position in a dynamic_space that maintains its coordinates and neighborhood type incrementally
+		class dynamic_location
+		{
+			const dynamic_space* space;
+			position_t pos1d;
+			unsigned hood;
+			std::array<unsigned, dynamic_space::max_dimension> coordinates; // outermost first
+
+		public:
+			dynamic_location(const dynamic_space& s, position_t pos)
+				: space(&s)
+				, pos1d(pos)
+				, hood(0)
+				, coordinates{}
+			{
+				for (unsigned d = s.dimension(); d-- > 0; pos /= s.extent(d))
+					coordinates[d] = (unsigned)(pos % s.extent(d));
+				if (pos1d == s.size())
+					coordinates[0] = s.extent(0); // end()
+				for (unsigned d = 0; d < s.dimension(); ++d)
+					hood += s.kind(d, coordinates[d]);
+			}
+			// construct by coordinates, outermost first
+			template <std::size_t N>
+			dynamic_location(const dynamic_space& s, const std::array<unsigned, N>& cc)
+				: space(&s)
+				, pos1d(0)
+				, hood(0)
+				, coordinates{}
+			{
+				static_assert(N <= dynamic_space::max_dimension, "too many coordinates");
+				if (N != s.dimension())
+					throw std::invalid_argument("dynamic_location: expected " + std::to_string(s.dimension()) + " coordinates");
+				for (unsigned d = 0; d < N; ++d) {
+					if (cc[d] >= s.extent(d))
+						throw std::out_of_range("dynamic_location: coordinate out of range");
+					coordinates[d] = cc[d];
+					pos1d = pos1d * s.extent(d) + cc[d];
+					hood += s.kind(d, cc[d]);
+				}
+			}
+
+			inline const dynamic_space& shape() const { return *space; }
+			inline operator position_t() const { return pos1d; }
+			inline unsigned type() const { return hood; }
+			// the coordinate of dimension d, 0 being the innermost
+			inline unsigned operator[](unsigned d) const { return coordinates[space->dimension() - 1 - d]; }
+
+			inline dynamic_location& operator++()
+			{
+				pos1d += 1;
+				for (unsigned d = space->dimension(); d-- > 0;) {
+					const unsigned old = space->kind(d, coordinates[d]);
+					const bool carry = ++coordinates[d] == space->extent(d) and d > 0;
+					if (carry)
+						coordinates[d] = 0;
+					hood += space->kind(d, coordinates[d]) - old;
+					if (not carry)
+						break;
+				}
+				return *this;
+			}
+			inline dynamic_location& operator--()
+			{
+				pos1d -= 1;
+				for (unsigned d = space->dimension(); d-- > 0;) {
+					const unsigned old = space->kind(d, coordinates[d]);
+					const bool borrow = coordinates[d] == 0;
+					coordinates[d] = borrow ? space->extent(d) - 1 : coordinates[d] - 1;
+					hood += space->kind(d, coordinates[d]) - old;
+					if (not borrow)
+						break;
+				}
+				return *this;
+			}
+			inline bool operator==(const dynamic_location& other) const { return pos1d == other.pos1d; }
+			inline bool operator!=(const dynamic_location& other) const { return pos1d != other.pos1d; }
+		};
+
+		// Grid of a shape given at run time, offering the API of grid<> so that the same kernels
+		// compile against either. Copies of a grid share its shape and offset tables.
+		template <typename T>
+		class dynamic_grid
+		{
+			std::shared_ptr<const dynamic_space> shape;
+			std::vector<T> data;
+
+		public:
+			typedef T value_type;
+			typedef typename std::vector<T>::reference reference;
+			typedef typename std::vector<T>::const_reference const_reference;
+			typedef offset_range neighborhood;
+
+			class iterator {
+			public:
+				using difference_type = std::ptrdiff_t;
+				using value_type = T;
+				using pointer = T*;
+				using reference = T&;
+				using iterator_category = std::bidirectional_iterator_tag;
+
+				std::vector<T>* _data;
+				dynamic_location _loc;
+
+				iterator(std::vector<T>& d, const dynamic_location& loc)
+					: _data(&d)
+					, _loc(loc)
+				{
+				}
+
+				inline operator position_t() const { return _loc; }
+				inline typename std::vector<T>::reference operator*() const { return (*_data)[_loc]; }
+				inline typename std::vector<T>::pointer operator->() const { return &(*_data)[_loc]; }
+
+				inline const offset_t* begin() const { return neighbors_offsets().begin(); }
+				inline const offset_t* end() const { return neighbors_offsets().end(); }
+				inline position_t size() const { return neighbors_offsets().size(); }
+				inline unsigned type() const { return _loc.type(); }
+
+				inline offset_range neighbors_offsets() const { return _loc.shape().neighbors_offsets(_loc.type()); }
+
+				inline iterator& operator++()
+				{
+					++_loc;
+					return *this;
+				}
+				inline iterator& operator--()
+				{
+					--_loc;
+					return *this;
+				}
+				inline bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+				inline bool operator==(const iterator& rhs) const { return _loc == rhs._loc; }
+				inline typename std::vector<T>::reference operator[](offset_t offset) const { return (*_data)[_loc + offset]; }
+				inline unsigned coordinate(unsigned c) const { return _loc[c]; }
+			};
+
+			struct const_iterator {
+				using difference_type = std::ptrdiff_t;
+				using value_type = T;
+				using pointer = const T*;
+				using reference = const T&;
+				using iterator_category = std::bidirectional_iterator_tag;
+
+				const std::vector<T>* _data;
+				dynamic_location _loc;
+
+				const_iterator(const std::vector<T>& d, const dynamic_location& loc)
+					: _data(&d)
+					, _loc(loc)
+				{
+				}
+
+				inline operator position_t() const { return _loc; }
+				inline typename std::vector<T>::const_reference operator*() const { return (*_data)[_loc]; }
+				inline typename std::vector<T>::const_pointer operator->() const { return &(*_data)[_loc]; }
+
+				inline const offset_t* begin() const { return neighbors_offsets().begin(); }
+				inline const offset_t* end() const { return neighbors_offsets().end(); }
+				inline position_t size() const { return neighbors_offsets().size(); }
+				inline unsigned type() const { return _loc.type(); }
+
+				inline offset_range neighbors_offsets() const { return _loc.shape().neighbors_offsets(_loc.type()); }
+
+				inline const_iterator& operator++()
+				{
+					++_loc;
+					return *this;
+				}
+				inline const_iterator& operator--()
+				{
+					--_loc;
+					return *this;
+				}
+				inline bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+				inline bool operator==(const const_iterator& rhs) const { return _loc == rhs._loc; }
+				inline typename std::vector<T>::const_reference operator[](offset_t offset) const
+				{
+					return (*_data)[_loc + offset];
+				}
+				inline unsigned coordinate(unsigned c) const { return _loc[c]; }
+			};
+
+		public:
+			dynamic_grid(std::shared_ptr<const dynamic_space> space, T _default = T())
+				: shape(std::move(space))
+				, data(shape->size(), _default)
+			{
+			}
+			dynamic_grid(std::vector<unsigned> extents, unsigned R, bool wrap, T _default = T())
+				: dynamic_grid(std::make_shared<const dynamic_space>(std::move(extents), R, wrap), _default)
+			{
+			}
+
+			inline const std::shared_ptr<const dynamic_space>& space() const { return shape; }
+			inline std::string info() const { return shape->info(); }
+
+			inline typename std::vector<T>::reference operator[](position_t pos) { return data[pos]; }
+			inline typename std::vector<T>::const_reference operator[](position_t pos) const { return data[pos]; }
+
+			inline position_t size() const { return shape->size(); }
+			inline position_t dimension() const { return shape->dimension(); }
+			inline position_t dimension(unsigned D) const { return shape->dimension(D); }
+
+			inline iterator begin() { return iterator(data, dynamic_location(*shape, 0)); }
+			inline iterator end() { return iterator(data, dynamic_location(*shape, size())); }
+			inline const_iterator begin() const { return const_iterator(data, dynamic_location(*shape, 0)); }
+			inline const_iterator end() const { return const_iterator(data, dynamic_location(*shape, size())); }
+
+			template <typename... CC>
+			inline iterator at(CC... cc)
+			{
+				return iterator(data, dynamic_location(*shape, std::array<unsigned, sizeof...(CC)>{ { (unsigned)cc... } }));
+			}
+			template <typename... CC>
+			inline const_iterator at(CC... cc) const
+			{
+				return const_iterator(data, dynamic_location(*shape, std::array<unsigned, sizeof...(CC)>{ { (unsigned)cc... } }));
+			}
+			inline offset_range neighbors_offsets(const dynamic_location& it) const { return shape->neighbors_offsets(it.type()); }
+			inline offset_range neighbors_offsets(unsigned nhood_type) const { return shape->neighbors_offsets(nhood_type); }
+
+			template <typename... CC>
+			inline typename std::vector<T>::reference operator()(CC... cc) { return *at(cc...); }
+			template <typename... CC>
+			inline typename std::vector<T>::const_reference operator()(CC... cc) const { return *at(cc...); }
+
+			friend void swap(dynamic_grid& lhs, dynamic_grid& rhs) noexcept
+			{
+				lhs.shape.swap(rhs.shape);
+				lhs.data.swap(rhs.data);
+			}
+
+			inline bool operator!=(const dynamic_grid& oth) const { return !(*this == oth); }
+			inline bool operator==(const dynamic_grid& oth) const
+			{
+				return (shape == oth.shape or *shape == *oth.shape) and data == oth.data;
+			}
+		};
+
 	} // namespace hyper
 } // namespace sprogar
 
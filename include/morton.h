@@ -0,0 +1,343 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_MORTON_H_
+#define _SPROGAR_HYPERSPACE_MORTON_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		namespace detail
+		{
+			// scatters the low bits of x to the set bits of mask, lowest first
+			constexpr std::uint64_t dilate(std::uint64_t x, std::uint64_t mask)
+			{
+				std::uint64_t out = 0;
+				for (std::uint64_t bit = 1; mask != 0; bit <<= 1, mask &= mask - 1)
+					if (x & bit)
+						out |= mask & (~mask + 1);
+				return out;
+			}
+			// gathers the bits of m at the set bits of mask into the low bits
+			constexpr std::uint64_t contract(std::uint64_t m, std::uint64_t mask)
+			{
+				std::uint64_t out = 0;
+				for (std::uint64_t bit = 1; mask != 0; bit <<= 1, mask &= mask - 1)
+					if (m & mask & (~mask + 1))
+						out |= bit;
+				return out;
+			}
+
+			// PDEP and PEXT, by BMI2 where available
+			inline std::uint64_t deposit(std::uint64_t x, std::uint64_t mask)
+			{
+#ifdef __BMI2__
+				return _pdep_u64(x, mask);
+#else
+				return dilate(x, mask);
+#endif
+			}
+			inline std::uint64_t extract(std::uint64_t m, std::uint64_t mask)
+			{
+#ifdef __BMI2__
+				return _pext_u64(m, mask);
+#else
+				return contract(m, mask);
+#endif
+			}
+		} // namespace detail
+
+		// Grid storing the cells in Morton (Z-curve) order: the bits of the coordinates are interleaved,
+		// so that cells close in any dimension are mostly close in memory and a high-dimensional
+		// neighborhood spans few cache lines. The extents are padded to powers of two. Iterators
+		// traverse the cells in storage order, and their neighbors' offsets are computed per cell from the
+		// dilated coordinates; operator()(cc...) and at(cc...) take the usual coordinates.
+		template <typename T, unsigned R, bool wrap, unsigned... XX>
+		class morton_grid
+		{
+			static_assert(sizeof...(XX) > 0, "morton_grid needs at least one dimension");
+
+			static constexpr unsigned D = sizeof...(XX);
+			static constexpr std::size_t N = detail::power(2 * R + 1, D); // the neighborhood box
+
+			static constexpr std::array<unsigned, D> extent{ { XX... } }; // outermost first
+
+			static constexpr unsigned bits(unsigned X)
+			{
+				unsigned b = 0;
+				while ((std::uint64_t(1) << b) < X)
+					b += 1;
+				return b;
+			}
+			static constexpr unsigned total_bits()
+			{
+				unsigned total = 0;
+				for (unsigned X : extent)
+					total += bits(X);
+				return total;
+			}
+			static_assert(total_bits() < 64, "too many cells for a 64-bit Morton code");
+
+			// the bits of each dimension's coordinate in the code, dealt round-robin from the innermost dimension
+			static constexpr std::array<std::uint64_t, D> make_masks()
+			{
+				std::array<std::uint64_t, D> masks{};
+				unsigned next = 0;
+				for (unsigned b = 0; next < total_bits(); ++b)
+					for (unsigned d = D; d-- > 0;)
+						if (b < bits(extent[d]))
+							masks[d] |= std::uint64_t(1) << next++;
+				return masks;
+			}
+
+			// the steps -R..R of each dimension modulo 2^bits, scattered to the dimension's bits
+			static constexpr auto make_dilated_steps()
+			{
+				std::array<std::array<std::uint64_t, 2 * R + 1>, D> steps{};
+				const auto masks = make_masks();
+				for (unsigned d = 0; d < D; ++d)
+					for (unsigned i = 0; i < 2 * R + 1; ++i) {
+						const std::uint64_t delta = std::uint64_t(i) - R;
+						steps[d][i] = detail::dilate(delta & ((std::uint64_t(1) << bits(extent[d])) - 1), masks[d]);
+					}
+				return steps;
+			}
+
+			// whether a wrapped dimension is short enough for the box to reach a cell more than once
+			static constexpr bool aliased()
+			{
+				for (unsigned X : extent)
+					if (wrap and X <= 2 * R)
+						return true;
+				return false;
+			}
+
+		public:
+			typedef std::vector<T> storage_type;
+			typedef T value_type;
+			typedef typename storage_type::reference reference;
+			typedef typename storage_type::const_reference const_reference;
+			typedef hyper::neighborhood<N> neighborhood;
+
+			static constexpr std::array<std::uint64_t, D> masks = make_masks();
+			static constexpr std::array<std::array<std::uint64_t, 2 * R + 1>, D> dilated_steps = make_dilated_steps();
+
+		private:
+			storage_type data;
+
+			template <typename Grid, typename Reference>
+			class basic_iterator {
+			public:
+				using difference_type = offset_t;
+				using value_type = T;
+				using pointer = void;
+				using reference = Reference;
+				using iterator_category = std::forward_iterator_tag;
+
+				Grid* _grid;
+				std::uint64_t _code;
+				std::array<unsigned, D> _c; // outermost first
+
+			private:
+				// skips the padding up to the next cell of the space
+				void settle()
+				{
+					for (; _code < storage_size(); ++_code) {
+						bool inside = true;
+						for (unsigned d = 0; d < D; ++d) {
+							_c[d] = (unsigned)detail::extract(_code, masks[d]);
+							inside = inside and _c[d] < extent[d];
+						}
+						if (inside)
+							return;
+					}
+				}
+
+			public:
+				basic_iterator(Grid& g, std::uint64_t code)
+					: _grid(&g)
+					, _code(code)
+					, _c{}
+				{
+					settle();
+				}
+
+				inline operator position_t() const { return _code; }
+				inline Reference operator*() const { return (*_grid)[_code]; }
+				inline Reference operator[](offset_t offset) const { return (*_grid)[_code + offset]; }
+
+				// the storage offsets of the cell's neighbors; they depend on the carries within each
+				// coordinate, so they are summed up per cell from the code steps in every dimension
+				neighborhood neighbors_offsets() const
+				{
+					constexpr unsigned W = 2 * R + 1;
+					std::array<std::array<offset_t, W>, D> step; // to the cells -R..R away in dimension d
+					std::array<std::array<bool, W>, D> inside;
+					for (unsigned d = 0; d < D; ++d) {
+						const std::uint64_t own = _code & masks[d];
+						for (unsigned i = 0; i < W; ++i) {
+							const offset_t X = extent[d], n = (offset_t)_c[d] + (offset_t)i - (offset_t)R;
+							std::uint64_t to = own;
+							inside[d][i] = wrap or (n >= 0 and n < X);
+							if (n >= 0 and n < X) // dilated addition within the dimension's bits
+								to = ((own | ~masks[d]) + dilated_steps[d][i]) & masks[d];
+							else if (wrap)
+								to = detail::deposit((std::uint64_t)((n % X + X) % X), masks[d]);
+							step[d][i] = (offset_t)(to - own);
+						}
+					}
+
+					// the box, expanded one dimension at a time from the outermost, and the cells in it
+					std::array<offset_t, N> box;
+					std::array<bool, N> valid;
+					box[0] = 0;
+					valid[0] = true;
+					for (std::size_t d = 0, n = 1; d < D; ++d, n *= W)
+						for (std::size_t j = n; j-- > 0;) {
+							const offset_t base = box[j];
+							const bool ok = valid[j];
+							for (unsigned i = W; i-- > 0;) {
+								box[j * W + i] = base + step[d][i];
+								valid[j * W + i] = ok and inside[d][i];
+							}
+						}
+					neighborhood hood;
+					for (std::size_t k = 0; k < N; ++k) {
+						bool listed = not valid[k] or box[k] == 0;
+						if (aliased()) // short wrapped dimensions reach cells more than once
+							for (std::size_t i = 0; i < hood.count and not listed; ++i)
+								listed = hood.offsets[i] == box[k];
+						if (not listed)
+							hood.offsets[hood.count++] = box[k];
+					}
+					return hood;
+				}
+				// the number of neighbors, counted from the coordinates unless short wrapped dimensions alias cells
+				inline position_t size() const
+				{
+					if (aliased())
+						return neighbors_offsets().size();
+					position_t count = 1;
+					for (unsigned d = 0; d < D; ++d) {
+						const offset_t c = _c[d], low = wrap ? c - R : std::max<offset_t>(c - R, 0);
+						const offset_t high = wrap ? c + R : std::min<offset_t>(c + R, (offset_t)extent[d] - 1);
+						count *= position_t(high - low + 1);
+					}
+					return count - 1;
+				}
+
+				// the neighbors, in a view that owns a copy of the offsets built for the cell
+				inline neighbor_view<basic_iterator, neighborhood, true> neighbors() const
+				{
+					return neighbor_view<basic_iterator, neighborhood, true>(*this, neighbors_offsets());
+				}
+
+				inline basic_iterator& operator++()
+				{
+					++_code;
+					settle();
+					return *this;
+				}
+				inline bool operator!=(const basic_iterator& rhs) const { return !(*this == rhs); }
+				inline bool operator==(const basic_iterator& rhs) const { return _code == rhs._code; }
+				inline unsigned coordinate(unsigned c) const { return _c[D - 1 - c]; }
+			};
+
+		public:
+			typedef basic_iterator<morton_grid, reference> iterator;
+			typedef basic_iterator<const morton_grid, const_reference> const_iterator;
+
+			morton_grid()
+				: data(storage_size())
+			{
+			}
+			morton_grid(T _default)
+				: data(storage_size(), _default)
+			{
+			}
+
+			static inline std::string info() { return iterable_space<wrap, R, XX...>::info() + " morton"; }
+
+			// the cells of the space, and the padded storage
+			inline static constexpr position_t size() { return iterable_space<wrap, R, XX...>::size(); }
+			inline static constexpr position_t storage_size() { return position_t(1) << total_bits(); }
+
+			inline static constexpr position_t dimension() { return D; }
+			inline static constexpr position_t dimension(unsigned d) { return iterable_space<wrap, R, XX...>::dimension(d); }
+
+			// the Morton code of the coordinates, outermost first
+			template <typename... CC>
+			static inline position_t index(CC... cc)
+			{
+				static_assert(sizeof...(CC) == D);
+				const std::array<unsigned, D> c{ { static_cast<unsigned>(cc)... } };
+				std::uint64_t code = 0;
+				for (unsigned d = 0; d < D; ++d) {
+					assert(c[d] < extent[d]);
+					code |= detail::deposit(c[d], masks[d]);
+				}
+				return code;
+			}
+
+			inline reference operator[](position_t code) { return data[code]; }
+			inline const_reference operator[](position_t code) const { return data[code]; }
+
+			template <typename... CC>
+			inline reference operator()(CC... cc) { return data[index(cc...)]; }
+			template <typename... CC>
+			inline const_reference operator()(CC... cc) const { return data[index(cc...)]; }
+
+			inline iterator begin() { return iterator(*this, 0); }
+			inline iterator end() { return iterator(*this, storage_size()); }
+			inline const_iterator begin() const { return const_iterator(*this, 0); }
+			inline const_iterator end() const { return const_iterator(*this, storage_size()); }
+
+			template <typename... CC>
+			inline iterator at(CC... cc) { return iterator(*this, index(cc...)); }
+			template <typename... CC>
+			inline const_iterator at(CC... cc) const { return const_iterator(*this, index(cc...)); }
+
+			inline storage_type& storage() { return data; }
+			inline const storage_type& storage() const { return data; }
+
+			friend void swap(morton_grid& lhs, morton_grid& rhs) noexcept { lhs.data.swap(rhs.data); }
+
+			inline bool operator!=(const morton_grid& oth) const { return !(*this == oth); }
+			inline bool operator==(const morton_grid& oth) const { return data == oth.data; }
+		};
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_PARTITION_H_
+#define _SPROGAR_HYPERSPACE_PARTITION_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hyper.h"
+#include "engine.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		// Moves buffers between the ranks of a distributed computation. exchange() is called by the
+		// ranks collectively; it sends and receives all the given messages, in any interleaving, and
+		// returns when all are complete. Messages between two ranks arrive in the order they were listed.
+		// An MPI backend maps exchange() to MPI_Isend/MPI_Irecv and MPI_Waitall.
+		class transport
+		{
+		public:
+			struct outgoing
+			{
+				unsigned peer;
+				const void* data;
+				std::size_t bytes;
+			};
+			struct incoming
+			{
+				unsigned peer;
+				void* data;
+				std::size_t bytes;
+			};
+
+			virtual ~transport() {}
+
+			virtual unsigned rank() const = 0;
+			virtual unsigned ranks() const = 0;
+			virtual void exchange(const std::vector<outgoing>& sends, const std::vector<incoming>& receives) = 0;
+			// Called by a rank that leaves the computation on an error, so that its peers fail in their
+			// next exchange() instead of waiting for it. An MPI backend maps abort() to MPI_Abort.
+			virtual void abort() {}
+		};
+
+		// Transport between ranks on one machine, connected pairwise by Unix socket pairs. The ranks
+		// may be threads of one process, mesh(n), or processes forked by fork(n). POSIX only.
+		class socket_transport : public transport
+		{
+			unsigned me = 0, count = 1;
+			std::vector<int> fds; // the socket to each peer, -1 for itself
+			std::vector<pid_t> children; // of rank 0 after fork()
+
+			socket_transport(unsigned rank, unsigned n)
+				: me(rank)
+				, count(n)
+				, fds(n, -1)
+			{
+			}
+			void close_all()
+			{
+				for (int& fd : fds)
+					if (fd >= 0) {
+						::close(fd);
+						fd = -1;
+					}
+			}
+
+		public:
+			socket_transport(socket_transport&& other) noexcept
+				: me(other.me)
+				, count(other.count)
+				, fds(std::move(other.fds))
+				, children(std::move(other.children))
+			{
+				other.fds.clear();
+			}
+			socket_transport& operator=(socket_transport&& other) noexcept
+			{
+				close_all();
+				me = other.me;
+				count = other.count;
+				fds = std::move(other.fds);
+				children = std::move(other.children);
+				other.fds.clear();
+				return *this;
+			}
+			~socket_transport() { close_all(); }
+
+			// the connected endpoints of n ranks, e.g. for n threads
+			static std::vector<socket_transport> mesh(unsigned n)
+			{
+				assert(n > 0);
+				std::vector<socket_transport> all;
+				for (unsigned r = 0; r < n; ++r)
+					all.push_back(socket_transport(r, n));
+				for (unsigned a = 0; a < n; ++a)
+					for (unsigned b = a + 1; b < n; ++b) {
+						int pair[2];
+						if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+							throw std::system_error(errno, std::generic_category(), "socketpair");
+						all[a].fds[b] = pair[0];
+						all[b].fds[a] = pair[1];
+					}
+				return all;
+			}
+			// Forks n - 1 child processes and returns the endpoint of the calling process: rank 0 in the
+			// parent, which reaps the children by join(), ranks 1..n-1 in the children, which should _exit().
+			static socket_transport fork(unsigned n)
+			{
+				std::vector<socket_transport> all = mesh(n);
+				std::vector<pid_t> pids;
+				for (unsigned r = 1; r < n; ++r) {
+					const pid_t pid = ::fork();
+					if (pid < 0)
+						throw std::system_error(errno, std::generic_category(), "fork");
+					if (pid == 0) {
+						socket_transport mine = std::move(all[r]);
+						all.clear(); // closes the other ranks' sockets
+						return mine;
+					}
+					pids.push_back(pid);
+				}
+				socket_transport mine = std::move(all[0]);
+				mine.children = std::move(pids);
+				return mine;
+			}
+			// waits for the forked ranks and returns the number of those that failed
+			unsigned join()
+			{
+				unsigned failed = 0;
+				for (pid_t pid : children) {
+					int status = 0;
+					while (::waitpid(pid, &status, 0) < 0 and errno == EINTR)
+						;
+					failed += not WIFEXITED(status) or WEXITSTATUS(status) != 0;
+				}
+				children.clear();
+				return failed;
+			}
+
+			unsigned rank() const override { return me; }
+			unsigned ranks() const override { return count; }
+			// closes the sockets, which the peers see as a disconnection
+			void abort() override { close_all(); }
+
+			void exchange(const std::vector<outgoing>& sends, const std::vector<incoming>& receives) override
+			{
+				struct pending
+				{
+					std::vector<std::pair<char*, std::size_t>> sends, receives; // in order
+					std::size_t send = 0, receive = 0; // the current messages
+				};
+				std::vector<pending> peers(count);
+				std::vector<const outgoing*> to_self;
+				for (const outgoing& out : sends)
+					if (out.peer == me)
+						to_self.push_back(&out);
+					else if (out.bytes > 0)
+						peers[out.peer].sends.emplace_back((char*)out.data, out.bytes);
+				std::size_t self = 0;
+				for (const incoming& in : receives)
+					if (in.peer == me) {
+						assert(self < to_self.size() and to_self[self]->bytes == in.bytes);
+						std::memcpy(in.data, to_self[self++]->data, in.bytes);
+					}
+					else if (in.bytes > 0)
+						peers[in.peer].receives.emplace_back((char*)in.data, in.bytes);
+
+				std::vector<pollfd> polled;
+				std::vector<unsigned> peer_of;
+				for (;;) {
+					polled.clear();
+					peer_of.clear();
+					for (unsigned p = 0; p < count; ++p) {
+						const short events = (peers[p].send < peers[p].sends.size() ? POLLOUT : 0)
+							| (peers[p].receive < peers[p].receives.size() ? POLLIN : 0);
+						if (events != 0) {
+							if (fds[p] < 0)
+								throw std::runtime_error("transport to rank " + std::to_string(p) + " is closed");
+							polled.push_back(pollfd{ fds[p], events, 0 });
+							peer_of.push_back(p);
+						}
+					}
+					if (polled.empty())
+						return;
+					if (::poll(polled.data(), polled.size(), -1) < 0) {
+						if (errno == EINTR)
+							continue;
+						throw std::system_error(errno, std::generic_category(), "poll");
+					}
+
+					for (std::size_t i = 0; i < polled.size(); ++i) {
+						pending& peer = peers[peer_of[i]];
+						if (polled[i].revents & POLLOUT) {
+							auto& msg = peer.sends[peer.send];
+							const ssize_t n = ::send(polled[i].fd, msg.first, msg.second, MSG_DONTWAIT | MSG_NOSIGNAL);
+							if (n < 0 and errno != EAGAIN and errno != EINTR)
+								throw std::system_error(errno, std::generic_category(), "send");
+							if (n > 0) {
+								msg.first += n;
+								msg.second -= (std::size_t)n;
+								peer.send += msg.second == 0;
+							}
+						}
+						if (polled[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+							if (peer.receive == peer.receives.size())
+								throw std::runtime_error("rank " + std::to_string(peer_of[i]) + " disconnected");
+							auto& msg = peer.receives[peer.receive];
+							const ssize_t n = ::recv(polled[i].fd, msg.first, msg.second, MSG_DONTWAIT);
+							if (n == 0)
+								throw std::runtime_error("rank " + std::to_string(peer_of[i]) + " disconnected");
+							if (n < 0 and errno != EAGAIN and errno != EINTR)
+								throw std::system_error(errno, std::generic_category(), "recv");
+							if (n > 0) {
+								msg.first += n;
+								msg.second -= (std::size_t)n;
+								peer.receive += msg.second == 0;
+							}
+						}
+					}
+				}
+			}
+		};
+
+		// One rank's part of a grid decomposed along its outermost dimension: the rank owns the rows
+		// partition(outer, ranks, rank) plus R halo rows on either side, which hold its neighbors'
+		// rows. step() computes the owned rows next to the halos first, sends them to the neighbors
+		// on a separate thread while it computes the interior rows, and waits for the neighbors' rows.
+		// The rule is a function of the cell and its neighbors, as in the stencil_engine.
+		template <class Grid>
+		class partitioned_grid
+		{
+		public:
+			typedef typename Grid::value_type value_type;
+			typedef std::vector<value_type> buffer;
+
+			static_assert(std::is_trivially_copyable<value_type>::value and not std::is_same<value_type, bool>::value,
+				"partitioned cells must be trivially copyable, and not packed bools");
+
+		private:
+			typedef typename Grid::space_offsets::iterator location;
+
+			static constexpr unsigned R = Grid::space_offsets::radius;
+			static constexpr bool wrap = Grid::space_offsets::wrapped;
+			static constexpr offset_t outer = Grid::dimension(Grid::dimension() - 1);
+			static constexpr offset_t plane = Grid::size() / outer;
+			static constexpr unsigned outer_weight = (unsigned)detail::power(2 * R + 1, Grid::dimension() - 1);
+
+			transport& net;
+			offset_t first, last; // the owned rows
+			buffer cells[2]; // rows first - R .. last + R
+			unsigned current = 0;
+
+			inline offset_t rows() const { return last - first; }
+			inline unsigned above() const { return (net.rank() + net.ranks() - 1) % net.ranks(); }
+			inline unsigned below() const { return (net.rank() + 1) % net.ranks(); }
+			inline bool has_above() const { return wrap or net.rank() > 0; }
+			inline bool has_below() const { return wrap or net.rank() + 1 < net.ranks(); }
+
+			// fills the halos of the buffer with the neighbors' rows
+			void exchange_halos(buffer& b)
+			{
+				const std::size_t bytes = R * plane * sizeof(value_type);
+				std::vector<transport::outgoing> sends;
+				std::vector<transport::incoming> receives;
+				// downwards first, so that two ranks which are each other's both neighbors match the order
+				if (has_below())
+					sends.push_back({ below(), &b[rows() * plane], bytes });
+				if (has_above())
+					sends.push_back({ above(), &b[R * plane], bytes });
+				if (has_above())
+					receives.push_back({ above(), &b[0], bytes });
+				if (has_below())
+					receives.push_back({ below(), &b[(R + rows()) * plane], bytes });
+				net.exchange(sends, receives);
+			}
+
+			template <class Rule>
+			void compute_rows(const buffer& in, buffer& out, offset_t from, offset_t to, Rule& rule) const
+			{
+				for (offset_t row = from; row < to; ++row) {
+					location loc(position_t((first + row) * plane));
+					position_t pos = (R + row) * plane;
+					for (offset_t p = 0; p < plane; ++p, ++pos, ++loc)
+						out[pos] = rule(in[pos], neighbor_view<buffer_cursor<buffer>, typename Grid::space_offsets::neighborhood>(
+							buffer_cursor<buffer>{ &in, pos }, Grid::neighbors_offsets(wrap ? loc.type() % outer_weight : loc.type())));
+				}
+			}
+
+		public:
+			// every rank takes its rows of the initial grid
+			partitioned_grid(transport& t, const Grid& initial)
+				: net(t)
+			{
+				const auto owned = partition(outer, t.ranks(), t.rank());
+				first = (offset_t)owned.first;
+				last = (offset_t)owned.second;
+				// the halos come from the adjacent ranks only; the smallest share is outer / ranks rows
+				if (t.ranks() > 1 and outer / (offset_t)t.ranks() < (offset_t)R)
+					throw std::invalid_argument("partitioned_grid: fewer than R rows per rank");
+				if (wrap and outer < 2 * (offset_t)R + 1)
+					throw std::invalid_argument("partitioned_grid: wrapped outermost extent below 2R+1");
+
+				for (buffer& b : cells)
+					b.resize((rows() + 2 * R) * plane);
+				for (offset_t pos = 0; pos < rows() * plane; ++pos)
+					cells[0][R * plane + pos] = initial[first * plane + pos];
+				exchange_halos(cells[0]);
+			}
+			partitioned_grid(const partitioned_grid&) = delete;
+			partitioned_grid& operator=(const partitioned_grid&) = delete;
+
+			// the owned rows [first, second) of the outermost dimension
+			inline std::pair<position_t, position_t> owned_rows() const { return { (position_t)first, (position_t)last }; }
+
+			// an owned cell, by its position in the whole grid
+			inline const value_type& operator[](position_t pos) const
+			{
+				assert((offset_t)pos >= first * plane and (offset_t)pos < last * plane);
+				return cells[current][pos - (first - R) * plane];
+			}
+
+			// advances all cells n times by rule(cell, neighbor_view)
+			template <class Rule>
+			void step(unsigned n, Rule rule)
+			{
+				const offset_t edge = std::min<offset_t>(R, rows());
+				try {
+					for (unsigned s = 0; s < n; ++s) {
+						const buffer& in = cells[current];
+						buffer& out = cells[1 - current];
+
+						compute_rows(in, out, 0, edge, rule);
+						compute_rows(in, out, std::max(edge, rows() - (offset_t)R), rows(), rule);
+						// the halos travel while the interior is computed; the future waits for the exchange
+						// also when the rule throws, and get() rethrows the errors of the exchange
+						std::future<void> halos = std::async(std::launch::async, [this, &out] { exchange_halos(out); });
+						compute_rows(in, out, edge, std::max(edge, rows() - (offset_t)R), rule);
+						halos.get();
+
+						current = 1 - current;
+					}
+				}
+				catch (...) {
+					// the peers would otherwise wait forever for the next halos of this rank
+					net.abort();
+					throw;
+				}
+			}
+
+			// collects the rows of all ranks into the grid of rank 0; called by all ranks
+			void gather(Grid& g)
+			{
+				std::vector<transport::outgoing> sends;
+				std::vector<transport::incoming> receives;
+				if (net.rank() == 0)
+					for (unsigned r = 0; r < net.ranks(); ++r) {
+						const auto owned = partition(outer, net.ranks(), r);
+						receives.push_back({ r, &g[owned.first * plane], (owned.second - owned.first) * plane * sizeof(value_type) });
+					}
+				sends.push_back({ 0, &cells[current][R * plane], rows() * plane * sizeof(value_type) });
+				net.exchange(sends, receives);
+			}
+		};
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
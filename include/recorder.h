@@ -0,0 +1,415 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_RECORDER_H_
+#define _SPROGAR_HYPERSPACE_RECORDER_H_
+
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		// Frame log format, version 1 (native byte order):
+		//   frame_log_header, followed by char info[info_length], the grid's info()
+		//   frames, each a frame_header followed by 'length' bytes of run-length encoded XOR delta
+		//   against the previous frame, or against zeros in keyframes.
+		// The encoding alternates a varint count of unchanged bytes with a varint count of changed
+		// bytes and the changed bytes (XOR-ed) themselves.
+		struct frame_log_header
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t cell_size;
+			std::uint64_t cells;
+			std::uint32_t keyframe_interval;
+			std::uint32_t info_length;
+		};
+		struct frame_header
+		{
+			std::uint64_t generation;
+			std::uint64_t length;
+			std::uint32_t keyframe;
+			std::uint32_t reserved;
+		};
+
+		constexpr char frame_log_magic[8] = { 'H', 'Y', 'P', 'E', 'R', 'L', 'O', 'G' };
+		constexpr std::uint32_t frame_log_version = 1;
+
+		namespace detail
+		{
+			typedef std::vector<unsigned char> bytes;
+
+			// the cells of the grid as raw bytes
+			template <class Grid>
+			void grid_to_bytes(const Grid& g, unsigned char* out)
+			{
+				typedef typename Grid::value_type T;
+				static_assert(std::is_trivially_copyable<T>::value, "recorded cells must be trivially copyable");
+				if constexpr (std::is_same<typename Grid::reference, T&>::value)
+					std::memcpy(out, &g[0], Grid::size() * sizeof(T));
+				else
+					for (position_t pos = 0; pos < Grid::size(); ++pos, out += sizeof(T)) {
+						const T cell = g[pos];
+						std::memcpy(out, &cell, sizeof(T));
+					}
+			}
+			template <class Grid>
+			void bytes_to_grid(const unsigned char* in, Grid& g)
+			{
+				typedef typename Grid::value_type T;
+				if constexpr (std::is_same<typename Grid::reference, T&>::value)
+					std::memcpy(&g[0], in, Grid::size() * sizeof(T));
+				else
+					for (position_t pos = 0; pos < Grid::size(); ++pos, in += sizeof(T)) {
+						T cell;
+						std::memcpy(&cell, in, sizeof(T));
+						g[pos] = cell;
+					}
+			}
+
+			inline void put_varint(bytes& out, std::uint64_t x)
+			{
+				for (; x >= 0x80; x >>= 7)
+					out.push_back((unsigned char)(x | 0x80));
+				out.push_back((unsigned char)x);
+			}
+			inline std::uint64_t get_varint(const unsigned char*& in, const unsigned char* end)
+			{
+				std::uint64_t x = 0;
+				for (unsigned shift = 0; in != end; shift += 7) {
+					const unsigned char b = *in++;
+					x |= std::uint64_t(b & 0x7f) << shift;
+					if (b < 0x80)
+						return x;
+				}
+				throw std::runtime_error("corrupt frame");
+			}
+
+			// appends the run-length encoded XOR of frame and previous (zeros if null) to out
+			inline void encode_delta(const bytes& frame, const unsigned char* previous, bytes& out)
+			{
+				auto changed = [&](std::size_t i) { return frame[i] != (previous ? previous[i] : 0); };
+				const std::size_t n = frame.size();
+
+				for (std::size_t i = 0; i < n;) {
+					const std::size_t same = i;
+					while (i < n and not changed(i))
+						i += 1;
+					const std::size_t first = i;
+					// a changed run ends at two unchanged bytes in a row
+					while (i < n and (changed(i) or (i + 1 < n and changed(i + 1))))
+						i += 1;
+
+					put_varint(out, first - same);
+					put_varint(out, i - first);
+					for (std::size_t k = first; k < i; ++k)
+						out.push_back(frame[k] ^ (previous ? previous[k] : 0));
+				}
+			}
+			// applies an encoded delta to the frame in place
+			inline void decode_delta(const unsigned char* in, const unsigned char* end, bytes& frame)
+			{
+				std::size_t i = 0;
+				while (in != end) {
+					i += get_varint(in, end);
+					const std::uint64_t changed = get_varint(in, end);
+					if (i + changed > frame.size() or (std::uint64_t)(end - in) < changed)
+						throw std::runtime_error("corrupt frame");
+					for (std::uint64_t k = 0; k < changed; ++k)
+						frame[i++] ^= *in++;
+				}
+			}
+
+			// 64-bit file positions, also where long has 32 bits
+			inline std::int64_t tell(std::FILE* file)
+			{
+#ifdef _WIN32
+				return _ftelli64(file);
+#else
+				return (std::int64_t)::ftello(file);
+#endif
+			}
+			inline bool seek(std::FILE* file, std::int64_t offset, int origin)
+			{
+#ifdef _WIN32
+				return _fseeki64(file, offset, origin) == 0;
+#else
+				return ::fseeko(file, (off_t)offset, origin) == 0;
+#endif
+			}
+
+			template <class Grid>
+			std::string frame_log_prologue(std::uint32_t keyframe_interval)
+			{
+				const std::string info = Grid::info();
+				frame_log_header header{};
+				std::memcpy(header.magic, frame_log_magic, sizeof header.magic);
+				header.version = frame_log_version;
+				header.cell_size = sizeof(typename Grid::value_type);
+				header.cells = Grid::size();
+				header.keyframe_interval = keyframe_interval;
+				header.info_length = (std::uint32_t)info.size();
+				return std::string(reinterpret_cast<const char*>(&header), sizeof header) + info;
+			}
+		} // namespace detail
+
+		// Appends every recorded generation of a grid to a frame log. record() only copies the cells;
+		// the frames are encoded and written by a background thread, which record() waits for only when
+		// 'pending' frames are queued already. The first write error is thrown by the following
+		// record() or by close(); the destructor closes the log without reporting it.
+		template <class Grid>
+		class frame_recorder
+		{
+			std::FILE* file;
+			const std::string path;
+			const std::uint32_t interval;
+			const std::size_t pending;
+			std::uint64_t generation = 0;
+
+			std::mutex mutex;
+			std::condition_variable cv;
+			std::deque<detail::bytes> queue;
+			std::vector<detail::bytes> spare; // recycled frame buffers
+			bool closing = false;
+			int error = 0; // errno of the first failed write
+			std::thread writer;
+
+			// keeps the first error
+			void fail(int code)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (error == 0)
+					error = code != 0 ? code : EIO;
+			}
+			void throw_error()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (error != 0)
+					throw std::system_error(error, std::generic_category(), path);
+			}
+
+			void write_frames()
+			{
+				detail::bytes previous, encoded;
+				for (std::uint64_t gen = 0;; ++gen) {
+					detail::bytes frame;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						cv.wait(lock, [this] { return closing or not queue.empty(); });
+						if (queue.empty())
+							return;
+						frame = std::move(queue.front());
+						queue.pop_front();
+					}
+					cv.notify_all();
+
+					const bool key = gen % interval == 0;
+					encoded.clear();
+					detail::encode_delta(frame, key ? nullptr : previous.data(), encoded);
+
+					const frame_header header{ gen, encoded.size(), key, 0 };
+					if (std::fwrite(&header, sizeof header, 1, file) != 1
+						or std::fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size())
+						fail(errno);
+
+					std::swap(previous, frame);
+					std::lock_guard<std::mutex> lock(mutex);
+					spare.push_back(std::move(frame));
+				}
+			}
+
+		public:
+			frame_recorder(const std::string& path, std::uint32_t keyframe_interval = 64, std::size_t max_pending = 4)
+				: file(std::fopen(path.c_str(), "wb"))
+				, path(path)
+				, interval(keyframe_interval)
+				, pending(max_pending)
+			{
+				assert(keyframe_interval > 0 and max_pending > 0);
+				if (file == nullptr)
+					throw std::system_error(errno, std::generic_category(), path);
+
+				const std::string prologue = detail::frame_log_prologue<Grid>(interval);
+				if (std::fwrite(prologue.data(), 1, prologue.size(), file) != prologue.size()) {
+					const int code = errno;
+					std::fclose(file);
+					throw std::system_error(code != 0 ? code : EIO, std::generic_category(), path);
+				}
+				writer = std::thread(&frame_recorder::write_frames, this);
+			}
+			frame_recorder(const frame_recorder&) = delete;
+			frame_recorder& operator=(const frame_recorder&) = delete;
+
+			~frame_recorder()
+			{
+				try {
+					close();
+				}
+				catch (const std::system_error&) {
+					// close() explicitly to learn about the failure
+				}
+			}
+
+			// queues the next generation
+			void record(const Grid& g)
+			{
+				assert(file != nullptr);
+				throw_error();
+				detail::bytes frame;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv.wait(lock, [this] { return queue.size() < pending; });
+					if (not spare.empty()) {
+						frame = std::move(spare.back());
+						spare.pop_back();
+					}
+				}
+				frame.resize(Grid::size() * sizeof(typename Grid::value_type));
+				detail::grid_to_bytes(g, frame.data());
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					queue.push_back(std::move(frame));
+				}
+				cv.notify_all();
+				generation += 1;
+			}
+
+			inline std::uint64_t frames() const { return generation; }
+
+			// writes the queued frames and closes the log
+			void close()
+			{
+				if (file == nullptr)
+					return;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					closing = true;
+				}
+				cv.notify_all();
+				writer.join();
+				if (std::fclose(file) != 0)
+					fail(errno);
+				file = nullptr;
+				throw_error();
+			}
+		};
+
+		// Reconstructs any recorded generation of a frame log, starting from the nearest keyframe,
+		// or from the last generation read if that is nearer.
+		template <class Grid>
+		class frame_reader
+		{
+			struct entry
+			{
+				std::int64_t offset; // of the encoded delta
+				std::uint64_t length;
+				bool keyframe;
+			};
+
+			std::FILE* file;
+			std::vector<entry> index;
+			detail::bytes frame, encoded;
+			std::uint64_t current = -1; // the generation held in 'frame'
+
+		public:
+			frame_reader(const std::string& path)
+				: file(std::fopen(path.c_str(), "rb"))
+			{
+				if (file == nullptr)
+					throw std::system_error(errno, std::generic_category(), path);
+
+				frame_log_header header;
+				std::string info(Grid::info());
+				const bool valid = std::fread(&header, sizeof header, 1, file) == 1
+					and std::memcmp(header.magic, frame_log_magic, sizeof header.magic) == 0
+					and header.version == frame_log_version and header.cell_size == sizeof(typename Grid::value_type)
+					and header.cells == Grid::size() and header.info_length == info.size()
+					and std::fread(&info[0], 1, info.size(), file) == info.size() and info == Grid::info();
+				if (not valid) {
+					std::fclose(file);
+					throw std::runtime_error(path + " is not a frame log of a " + Grid::info() + " grid");
+				}
+
+				frame_header fh;
+				while (std::fread(&fh, sizeof fh, 1, file) == 1) {
+					index.push_back(entry{ detail::tell(file), fh.length, fh.keyframe != 0 });
+					if (not detail::seek(file, (std::int64_t)fh.length, SEEK_CUR))
+						break;
+				}
+				frame.resize(Grid::size() * sizeof(typename Grid::value_type));
+			}
+			frame_reader(const frame_reader&) = delete;
+			frame_reader& operator=(const frame_reader&) = delete;
+
+			~frame_reader() { std::fclose(file); }
+
+			inline std::uint64_t frames() const { return index.size(); }
+
+			// writes the given generation into the grid
+			void read(std::uint64_t generation, Grid& g)
+			{
+				assert(generation < index.size());
+				std::uint64_t start = generation;
+				while (not index[start].keyframe)
+					start -= 1;
+				// continue from the generation read last if it lies between the keyframe and the requested one
+				if (current != std::uint64_t(-1) and current >= start and current <= generation)
+					start = current + 1;
+
+				for (std::uint64_t gen = start; gen <= generation; ++gen) {
+					encoded.resize(index[gen].length);
+					if (not detail::seek(file, index[gen].offset, SEEK_SET)
+						or std::fread(encoded.data(), 1, encoded.size(), file) != encoded.size())
+						throw std::runtime_error("truncated frame log");
+					if (index[gen].keyframe)
+						std::fill(frame.begin(), frame.end(), 0);
+					detail::decode_delta(encoded.data(), encoded.data() + encoded.size(), frame);
+				}
+				current = generation;
+				detail::bytes_to_grid(frame.data(), g);
+			}
+			Grid read(std::uint64_t generation)
+			{
+				Grid g;
+				read(generation, g);
+				return g;
+			}
+		};
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_SNAPSHOT_H_
+#define _SPROGAR_HYPERSPACE_SNAPSHOT_H_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "hyper.h"
+#include "storage.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		// Snapshot file format, version 1 (native byte order):
+		//   snapshot_header
+		//   uint64_t extents[dimensions], outermost first
+		//   char info[info_length], the grid's info()
+		//   zero padding up to 'payload', a multiple of snapshot_alignment
+		//   the raw cells, as laid out in memory
+		struct snapshot_header
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t cell_size;
+			std::uint32_t radius;
+			std::uint32_t wrap;
+			std::uint32_t dimensions;
+			std::uint32_t info_length;
+			std::uint64_t cells;
+			std::uint64_t payload; // file offset of the cells
+		};
+
+		constexpr char snapshot_magic[8] = { 'H', 'Y', 'P', 'E', 'R', 'S', 'N', 'P' };
+		constexpr std::uint32_t snapshot_version = 1;
+		constexpr std::size_t snapshot_alignment = 4096; // lets the cells be mapped in place
+
+		namespace detail
+		{
+			// the complete header of a snapshot of the given grid type, padded to the payload
+			template <class Grid>
+			std::vector<char> snapshot_prologue()
+			{
+				typedef typename Grid::value_type T;
+				const std::string info = Grid::info();
+
+				snapshot_header header{};
+				std::memcpy(header.magic, snapshot_magic, sizeof header.magic);
+				header.version = snapshot_version;
+				header.cell_size = sizeof(T);
+				header.radius = Grid::space_offsets::radius;
+				header.wrap = Grid::space_offsets::wrapped;
+				header.dimensions = (std::uint32_t)Grid::dimension();
+				header.info_length = (std::uint32_t)info.size();
+				header.cells = Grid::size();
+
+				const std::size_t used = sizeof header + Grid::dimension() * sizeof(std::uint64_t) + info.size();
+				header.payload = (used + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+
+				std::vector<char> prologue(header.payload, 0);
+				char* out = prologue.data();
+				std::memcpy(out, &header, sizeof header);
+				out += sizeof header;
+				for (unsigned d = (unsigned)Grid::dimension(); d-- > 0; out += sizeof(std::uint64_t)) {
+					const std::uint64_t extent = Grid::dimension(d);
+					std::memcpy(out, &extent, sizeof extent);
+				}
+				std::memcpy(out, info.data(), info.size());
+				return prologue;
+			}
+
+			template <class Grid>
+			void check_contiguous()
+			{
+				typedef typename Grid::value_type T;
+				static_assert(std::is_trivially_copyable<T>::value, "snapshot cells must be trivially copyable");
+				static_assert(std::is_same<typename Grid::reference, T&>::value, "snapshot cells must be stored contiguously");
+			}
+
+			// fd's file offset of the cells, if the file holds a snapshot of the given grid type
+			template <class Grid>
+			std::uint64_t read_prologue(int fd, const std::string& path)
+			{
+				const std::vector<char> expected = snapshot_prologue<Grid>();
+				std::vector<char> prologue(expected.size());
+
+				std::size_t done = 0;
+				while (done < prologue.size()) {
+					const ssize_t n = ::pread(fd, prologue.data() + done, prologue.size() - done, (off_t)done);
+					if (n < 0 and errno == EINTR)
+						continue;
+					if (n < 0)
+						throw std::system_error(errno, std::generic_category(), path);
+					if (n == 0)
+						break;
+					done += (std::size_t)n;
+				}
+				if (done < prologue.size() or prologue != expected)
+					throw std::runtime_error(path + " is not a snapshot of a " + Grid::info() + " grid");
+
+				snapshot_header header;
+				std::memcpy(&header, prologue.data(), sizeof header);
+				return header.payload;
+			}
+		} // namespace detail
+
+		// Writes the grid to a snapshot file with a single gathered write of the header and the cells.
+		template <class Grid>
+		void save_snapshot(const Grid& g, const std::string& path)
+		{
+			detail::check_contiguous<Grid>();
+			const std::vector<char> prologue = detail::snapshot_prologue<Grid>();
+
+			const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0)
+				throw std::system_error(errno, std::generic_category(), path);
+
+			iovec parts[2] = {
+				{ const_cast<char*>(prologue.data()), prologue.size() },
+				{ const_cast<typename Grid::value_type*>(&g[0]), Grid::size() * sizeof(typename Grid::value_type) }
+			};
+			iovec* part = parts;
+			int left = 2;
+			while (left > 0) {
+				const ssize_t n = ::writev(fd, part, left);
+				if (n < 0 and errno == EINTR)
+					continue;
+				if (n < 0) {
+					const int error = errno;
+					::close(fd);
+					throw std::system_error(error, std::generic_category(), path);
+				}
+				// large writes may be partial
+				std::size_t written = (std::size_t)n;
+				for (; left > 0 and written >= part->iov_len; ++part, --left)
+					written -= part->iov_len;
+				if (left > 0) {
+					part->iov_base = static_cast<char*>(part->iov_base) + written;
+					part->iov_len -= written;
+				}
+			}
+			// the checkpoint is only complete once it reached the disk
+			if (::fsync(fd) < 0) {
+				const int error = errno;
+				::close(fd);
+				throw std::system_error(error, std::generic_category(), path);
+			}
+			if (::close(fd) < 0)
+				throw std::system_error(errno, std::generic_category(), path);
+		}
+
+		// Reads a snapshot of the same grid type into the grid.
+		template <class Grid>
+		void load_snapshot(Grid& g, const std::string& path)
+		{
+			detail::check_contiguous<Grid>();
+
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				throw std::system_error(errno, std::generic_category(), path);
+			try {
+				const std::uint64_t payload = detail::read_prologue<Grid>(fd, path);
+
+				char* cells = reinterpret_cast<char*>(&g[0]);
+				const std::size_t length = Grid::size() * sizeof(typename Grid::value_type);
+				std::size_t done = 0;
+				while (done < length) {
+					const ssize_t n = ::pread(fd, cells + done, length - done, (off_t)(payload + done));
+					if (n < 0 and errno == EINTR)
+						continue;
+					if (n < 0)
+						throw std::system_error(errno, std::generic_category(), path);
+					if (n == 0)
+						throw std::runtime_error(path + " is truncated");
+					done += (std::size_t)n;
+				}
+			}
+			catch (...) {
+				::close(fd);
+				throw;
+			}
+			::close(fd);
+		}
+
+		// Maps the cells of a snapshot in place, without reading them. Changes of the grid are
+		// written back to the snapshot, unless the snapshot is read-only, in which case they stay in memory.
+		template <typename T, unsigned R, bool wrap, unsigned... XX>
+		mapped_grid<T, R, wrap, XX...> map_snapshot(const std::string& path)
+		{
+			typedef mapped_grid<T, R, wrap, XX...> Grid;
+			typedef typename mapped_storage<T>::mapping mapping;
+			detail::check_contiguous<Grid>();
+
+			mapping mode = mapping::existing;
+			int fd = ::open(path.c_str(), O_RDWR);
+			if (fd < 0 and (errno == EACCES or errno == EROFS)) {
+				mode = mapping::private_copy;
+				fd = ::open(path.c_str(), O_RDONLY);
+			}
+			if (fd < 0)
+				throw std::system_error(errno, std::generic_category(), path);
+			std::uint64_t payload;
+			try {
+				payload = detail::read_prologue<Grid>(fd, path);
+				struct stat info;
+				if (::fstat(fd, &info) < 0)
+					throw std::system_error(errno, std::generic_category(), path);
+				if ((std::uint64_t)info.st_size < payload + Grid::size() * sizeof(T))
+					throw std::runtime_error(path + " is truncated");
+			}
+			catch (...) {
+				::close(fd);
+				throw;
+			}
+			::close(fd);
+			return Grid(mapped_storage<T>(path, Grid::size(), payload, mode));
+		}
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_SOA_H_
+#define _SPROGAR_HYPERSPACE_SOA_H_
+
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		template <typename Tuple, unsigned R, bool wrap, unsigned... XX>
+		class soa_grid;
+
+		// Structure-of-arrays grid: the cells are tuples, but each field is kept in its own contiguous
+		// array, field<I>(), so that sweeps over some fields of the neighbors touch only those arrays.
+		// A cell as a whole is accessed through a tuple of references.
+		template <typename... Fields, unsigned R, bool wrap, unsigned... XX>
+		class soa_grid<std::tuple<Fields...>, R, wrap, XX...>
+		{
+			static_assert(sizeof...(Fields) > 0, "soa_grid needs at least one field");
+
+		public:
+			typedef iterable_offsets<wrap, R, XX...> space_offsets;
+			typedef std::tuple<Fields...> value_type;
+			typedef std::tuple<typename std::vector<Fields>::reference...> reference;
+			typedef std::tuple<typename std::vector<Fields>::const_reference...> const_reference;
+
+			template <std::size_t I>
+			using field_type = typename std::tuple_element<I, value_type>::type;
+
+		private:
+			typedef std::index_sequence_for<Fields...> all_fields;
+
+			std::tuple<std::vector<Fields>...> columns;
+
+			template <std::size_t... I>
+			inline reference cell(position_t pos, std::index_sequence<I...>) { return reference(std::get<I>(columns)[pos]...); }
+			template <std::size_t... I>
+			inline const_reference cell(position_t pos, std::index_sequence<I...>) const { return const_reference(std::get<I>(columns)[pos]...); }
+			template <std::size_t... I>
+			void fill(const value_type& value, std::index_sequence<I...>)
+			{
+				(std::get<I>(columns).assign(space_offsets::size(), std::get<I>(value)), ...);
+			}
+
+			template <typename Grid, typename Reference>
+			class basic_iterator {
+			public:
+				using difference_type = std::ptrdiff_t;
+				using value_type = std::tuple<Fields...>;
+				using pointer = void;
+				using reference = Reference;
+				using iterator_category = std::bidirectional_iterator_tag;
+
+				Grid* _grid;
+				location_iterator<R, XX...> _loc;
+
+				basic_iterator(Grid& g, const location_iterator<R, XX...>& loc)
+					: _grid(&g)
+					, _loc(loc)
+				{
+				}
+
+				inline operator position_t() const { return _loc; }
+				inline Reference operator*() const { return (*_grid)[_loc]; }
+				inline Reference operator[](offset_t offset) const { return (*_grid)[_loc + offset]; }
+
+				// field I of this cell, or of the neighbor at the given offset
+				template <std::size_t I>
+				inline decltype(auto) get(offset_t offset = 0) const { return _grid->template field<I>()[_loc + offset]; }
+
+				inline const offset_t* begin() const
+				{
+					return space_offsets::neighbors_offsets(_loc.type()).begin();
+				}
+				inline const offset_t* end() const
+				{
+					return space_offsets::neighbors_offsets(_loc.type()).end();
+				}
+				inline position_t size() const { return space_offsets::neighbors_offsets(_loc.type()).size(); }
+				inline unsigned type() const { return _loc.type(); }
+
+				inline const typename space_offsets::neighborhood& neighbors_offsets() const
+				{
+					return space_offsets::neighbors_offsets(_loc.type());
+				}
+
+				inline basic_iterator& operator++()
+				{
+					++_loc;
+					return *this;
+				}
+				inline basic_iterator& operator--()
+				{
+					--_loc;
+					return *this;
+				}
+				inline bool operator!=(const basic_iterator& rhs) const { return !(*this == rhs); }
+				inline bool operator==(const basic_iterator& rhs) const { return _loc == rhs._loc; }
+				inline unsigned coordinate(unsigned c) const { return _loc[c]; }
+			};
+
+		public:
+			typedef basic_iterator<soa_grid, reference> iterator;
+			typedef basic_iterator<const soa_grid, const_reference> const_iterator;
+
+			soa_grid()
+			{
+				fill(value_type(), all_fields());
+			}
+			soa_grid(const value_type& _default)
+			{
+				fill(_default, all_fields());
+			}
+
+			static inline constexpr std::string info() { return space_offsets::info(); }
+
+			inline reference operator[](position_t pos) { return cell(pos, all_fields()); }
+			inline const_reference operator[](position_t pos) const { return cell(pos, all_fields()); }
+
+			// the contiguous array of field I
+			template <std::size_t I>
+			inline std::vector<field_type<I>>& field() { return std::get<I>(columns); }
+			template <std::size_t I>
+			inline const std::vector<field_type<I>>& field() const { return std::get<I>(columns); }
+
+			inline static constexpr position_t size() { return space_offsets::size(); }
+
+			inline static constexpr position_t dimension() { return sizeof...(XX); }
+			inline static constexpr position_t dimension(unsigned D) { return space_offsets::dimension(D); }
+
+			inline iterator begin() { return iterator(*this, space_offsets::begin()); }
+			inline iterator end() { return iterator(*this, space_offsets::end()); }
+			inline const_iterator begin() const { return const_iterator(*this, space_offsets::begin()); }
+			inline const_iterator end() const { return const_iterator(*this, space_offsets::end()); }
+
+			// the same location in this grid
+			template <typename Iterator>
+			inline iterator imap(const Iterator& it) { return iterator(*this, it._loc); }
+			template <typename Iterator>
+			inline const_iterator imap(const Iterator& it) const { return const_iterator(*this, it._loc); }
+
+			template <typename... CC>
+			inline iterator at(CC... cc)
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return iterator(*this, location_iterator<R, XX...>(cc...));
+			}
+			template <typename... CC>
+			inline const_iterator at(CC... cc) const
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return const_iterator(*this, location_iterator<R, XX...>(cc...));
+			}
+			inline static const typename space_offsets::neighborhood& neighbors_offsets(const location_iterator<R, XX...>& it)
+			{
+				return space_offsets::neighbors_offsets(it.type());
+			}
+			inline static const typename space_offsets::neighborhood& neighbors_offsets(unsigned nhood_type)
+			{
+				return space_offsets::neighbors_offsets(nhood_type);
+			}
+
+			template <typename... CC>
+			inline reference operator()(CC... cc)
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return (*this)[(position_t)location_iterator<R, XX...>(cc...)];
+			}
+			template <typename... CC>
+			inline const_reference operator()(CC... cc) const
+			{
+				static_assert(sizeof...(CC) == sizeof...(XX));
+				return (*this)[(position_t)location_iterator<R, XX...>(cc...)];
+			}
+
+			friend void swap(soa_grid& lhs, soa_grid& rhs) noexcept { lhs.columns.swap(rhs.columns); }
+
+			inline bool operator!=(const soa_grid& oth) const { return !(*this == oth); }
+			inline bool operator==(const soa_grid& oth) const { return columns == oth.columns; }
+		};
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
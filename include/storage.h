@@ -0,0 +1,200 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_STORAGE_H_
+#define _SPROGAR_HYPERSPACE_STORAGE_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		// Cell storage for basic_grid<> mapped into memory by mmap(). A file-backed storage maps
+		// the cells from a file, so the grid may exceed the RAM and survives restarts; paging is left
+		// to the OS. Without a file the cells live in anonymous memory, which is where copies go too.
+		// POSIX only.
+		template <typename T>
+		class mapped_storage
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "mapped cells must be trivially copyable");
+
+		public:
+			typedef T value_type;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef T* pointer;
+			typedef const T* const_pointer;
+			typedef T* iterator;
+			typedef const T* const_iterator;
+
+			// access patterns for advise()
+			enum class access { normal = MADV_NORMAL, sequential = MADV_SEQUENTIAL, random = MADV_RANDOM, willneed = MADV_WILLNEED };
+			// how the file constructor maps the file: create (or extend) it, map an existing file that holds
+			// the cells, or map the cells of a read-only file privately, keeping the changes in memory
+			enum class mapping { create, existing, private_copy };
+
+		private:
+			void* base = nullptr; // the start of the mapping, aligned to a page
+			std::size_t length = 0; // of the mapping
+			T* cells = nullptr;
+			position_t count = 0;
+
+			void map_anonymous(position_t n)
+			{
+				count = n;
+				length = std::max<std::size_t>(n * sizeof(T), 1);
+				base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (base == MAP_FAILED)
+					throw std::system_error(errno, std::generic_category(), "mmap");
+				cells = static_cast<T*>(base);
+			}
+
+		public:
+			mapped_storage()
+			{
+				map_anonymous(0);
+			}
+			explicit mapped_storage(position_t n)
+			{
+				map_anonymous(n); // zero-filled
+			}
+			mapped_storage(position_t n, const T& value)
+			{
+				map_anonymous(n);
+				std::fill(begin(), end(), value);
+			}
+			// Maps n cells from the file at the given byte offset. By default the file is created or
+			// extended if it is shorter, and changes are written back to the file; mapping::existing and
+			// mapping::private_copy require the file to hold the cells and throw otherwise.
+			mapped_storage(const std::string& path, position_t n, std::size_t offset = 0, mapping mode = mapping::create)
+				: count(n)
+			{
+				assert(offset % alignof(T) == 0);
+				const int flags = mode == mapping::create ? O_RDWR | O_CREAT : mode == mapping::existing ? O_RDWR : O_RDONLY;
+				const int fd = ::open(path.c_str(), flags, 0644);
+				if (fd < 0)
+					throw std::system_error(errno, std::generic_category(), path);
+
+				const std::size_t page = (std::size_t)::sysconf(_SC_PAGESIZE);
+				const std::size_t skip = offset % page;
+				const std::size_t end = offset + n * sizeof(T);
+				length = std::max<std::size_t>(skip + n * sizeof(T), 1);
+
+				struct stat info;
+				if (::fstat(fd, &info) < 0 or (mode == mapping::create and (std::size_t)info.st_size < end and ::ftruncate(fd, (off_t)end) < 0)) {
+					const int error = errno;
+					::close(fd);
+					throw std::system_error(error, std::generic_category(), path);
+				}
+				if ((std::size_t)info.st_size < end and mode != mapping::create) {
+					::close(fd);
+					throw std::runtime_error(path + " is too short for the cells");
+				}
+				base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, mode == mapping::private_copy ? MAP_PRIVATE : MAP_SHARED,
+					fd, (off_t)(offset - skip));
+				const int error = errno;
+				::close(fd); // the mapping keeps the file open
+				if (base == MAP_FAILED)
+					throw std::system_error(error, std::generic_category(), path);
+				cells = reinterpret_cast<T*>(static_cast<char*>(base) + skip);
+			}
+
+			mapped_storage(const mapped_storage& other)
+			{
+				map_anonymous(other.count);
+				std::copy(other.begin(), other.end(), begin());
+			}
+			mapped_storage(mapped_storage&& other) noexcept
+			{
+				swap(other);
+			}
+			mapped_storage& operator=(mapped_storage other) noexcept
+			{
+				swap(other);
+				return *this;
+			}
+			~mapped_storage()
+			{
+				if (base != nullptr)
+					::munmap(base, length);
+			}
+
+			inline position_t size() const { return count; }
+			inline T* data() { return cells; }
+			inline const T* data() const { return cells; }
+
+			inline T& operator[](position_t pos) { return cells[pos]; }
+			inline const T& operator[](position_t pos) const { return cells[pos]; }
+
+			inline T* begin() { return cells; }
+			inline T* end() { return cells + count; }
+			inline const T* begin() const { return cells; }
+			inline const T* end() const { return cells + count; }
+
+			// tells the OS how the cells will be accessed, e.g. sequential for full sweeps
+			void advise(access pattern) const
+			{
+				if (::madvise(base, length, (int)pattern) < 0)
+					throw std::system_error(errno, std::generic_category(), "madvise");
+			}
+			// writes the changed cells back to the file
+			void sync() const
+			{
+				if (::msync(base, length, MS_SYNC) < 0)
+					throw std::system_error(errno, std::generic_category(), "msync");
+			}
+
+			void swap(mapped_storage& other) noexcept
+			{
+				std::swap(base, other.base);
+				std::swap(length, other.length);
+				std::swap(cells, other.cells);
+				std::swap(count, other.count);
+			}
+
+			inline bool operator!=(const mapped_storage& other) const { return !(*this == other); }
+			inline bool operator==(const mapped_storage& other) const
+			{
+				return count == other.count and std::equal(begin(), end(), other.begin());
+			}
+		};
+
+		template <typename T, unsigned R, bool wrap, unsigned... XX>
+		using mapped_grid = basic_grid<mapped_storage<T>, moore, R, wrap, XX...>;
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
@@ -0,0 +1,374 @@
+/*
+ * Copyright 2018 Matej Sprogar <matej.sprogar@gmail.com>
+ *
+ * This file is part of Hyperspace.
+ *
+ * Hyperspace is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Hyperspace is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hyperspace.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * */
+
+#ifndef _SPROGAR_HYPERSPACE_TILED_H_
+#define _SPROGAR_HYPERSPACE_TILED_H_
+
+#include <array>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "hyper.h"
+
+namespace sprogar
+{
+	namespace hyper
+	{
+		// Grid split into tiles of B^D cells, each stored contiguously (row-major inside the tile,
+		// tiles in row-major order), so that neighbors in the outer dimensions are at most a tile
+		// apart instead of a whole plane. The extents are padded to multiples of B. Iterators walk
+		// tile by tile; cells at least R from the faces of their tile share one table of in-tile
+		// offsets, the others sum theirs from the steps of their position class in each dimension.
+		// Tiles are also the unit of work: tile_begin(t) and tile_end(t) delimit the cells of tile t.
+		template <typename T, unsigned B, unsigned R, bool wrap, unsigned... XX>
+		class tiled_grid
+		{
+			static_assert(sizeof...(XX) > 0, "tiled_grid needs at least one dimension");
+			static_assert(B > 0, "tiles need cells");
+
+			static constexpr unsigned D = sizeof...(XX);
+			static constexpr std::size_t N = detail::power(2 * R + 1, D); // the neighborhood box
+
+			static constexpr std::array<unsigned, D> extent{ { XX... } }; // outermost first
+			static constexpr std::array<unsigned, D> tiles_per{ { (XX + B - 1) / B... } };
+
+			// the in-tile offsets of the neighbors of cells away from the tile's faces
+			static constexpr auto make_tile_interior()
+			{
+				hyper::neighborhood<N> hood{};
+				for (std::size_t k = 0; k < N; ++k) {
+					if (k == N / 2)
+						continue;
+					offset_t off = 0, stride = 1;
+					std::size_t rest = k;
+					for (unsigned d = D; d-- > 0; rest /= 2 * R + 1, stride *= B)
+						off += (offset_t(rest % (2 * R + 1)) - R) * stride;
+					hood.offsets[hood.count++] = off;
+				}
+				return hood;
+			}
+
+			// A cell's position class in each dimension: 0 away from the faces of its tile, 1 + l at local
+			// coordinate l < R, 1 + R + j at local B - 1 - j, 1 + 2R + g at global g < R and 1 + 3R + j at
+			// global X - 1 - j. The class of each dimension selects the steps to the neighbors in it.
+			static constexpr unsigned classes = 1 + 4 * R;
+
+			static constexpr bool aliased() // a short wrapped dimension reaches cells more than once
+			{
+				for (unsigned X : extent)
+					if (wrap and X <= 2 * R)
+						return true;
+				return false;
+			}
+
+		public:
+			typedef std::vector<T> storage_type;
+			typedef T value_type;
+			typedef typename storage_type::reference reference;
+			typedef typename storage_type::const_reference const_reference;
+			typedef hyper::neighborhood<N> neighborhood;
+
+			static constexpr position_t tile_cells = detail::power(B, D);
+			static constexpr neighborhood tile_interior = make_tile_interior();
+
+		private:
+			storage_type data;
+
+			// the storage position of the cell at the coordinates (outermost first)
+			static inline position_t address(const std::array<unsigned, D>& c)
+			{
+				position_t tile = 0, local = 0;
+				for (unsigned d = 0; d < D; ++d) {
+					tile = tile * tiles_per[d] + c[d] / B;
+					local = local * B + c[d] % B;
+				}
+				return tile * tile_cells + local;
+			}
+
+			// the storage steps to the cells -R..R away, and whether they are in the space, per dimension and class
+			struct face_steps
+			{
+				std::array<std::array<std::array<offset_t, 2 * R + 1>, classes>, D> step{};
+				std::array<std::array<std::array<bool, 2 * R + 1>, classes>, D> inside{};
+			};
+
+			static face_steps make_steps()
+			{
+				constexpr unsigned W = 2 * R + 1;
+				face_steps s;
+				position_t tile_stride = tile_cells, local_stride = 1;
+				for (unsigned d = D; d-- > 0; tile_stride *= tiles_per[d], local_stride *= B) {
+					const offset_t X = extent[d];
+					auto at = [&](offset_t g) { return (offset_t)((g / B) * tile_stride + (g % B) * local_stride); };
+					for (unsigned k = 0; k < classes; ++k) {
+						// a cell of the class, in a tile far enough from the origin for the steps inside the space
+						const offset_t far = offset_t(R + 1) * B;
+						offset_t g = far + R;
+						if (k > 3 * R)
+							g = X - 1 - offset_t(k - 1 - 3 * R);
+						else if (k > 2 * R)
+							g = offset_t(k - 1 - 2 * R);
+						else if (k > R)
+							g = far + B - 1 - offset_t(k - 1 - R);
+						else if (k > 0)
+							g = far + offset_t(k - 1);
+						for (unsigned i = 0; i < W; ++i) {
+							const offset_t n = g + (offset_t)i - (offset_t)R;
+							if (k > 2 * R) { // at the border of the space, unless no cell is in the class
+								s.inside[d][k][i] = wrap or (n >= 0 and n < X);
+								s.step[d][k][i] = g >= 0 and g < X ? at((n % X + X) % X) - at(g) : 0;
+							}
+							else { // inside the space, maybe across tiles
+								s.inside[d][k][i] = true;
+								s.step[d][k][i] = at(n) - at(g);
+							}
+						}
+					}
+				}
+				return s;
+			}
+			static const face_steps& steps()
+			{
+				static const face_steps all = make_steps();
+				return all;
+			}
+
+			template <typename Grid, typename Reference>
+			class basic_iterator {
+			public:
+				using difference_type = offset_t;
+				using value_type = T;
+				using pointer = void;
+				using reference = Reference;
+				using iterator_category = std::forward_iterator_tag;
+
+				Grid* _grid;
+				position_t _pos;
+				std::array<unsigned, D> _tile; // tile coordinates, outermost first
+				std::array<unsigned, D> _local; // coordinates within the tile
+
+			private:
+				inline unsigned global(unsigned d) const { return _tile[d] * B + _local[d]; }
+
+				// skips the padding up to the next cell of the space
+				void settle()
+				{
+					while (_pos < storage_size()) {
+						bool inside = true;
+						for (unsigned d = 0; d < D; ++d)
+							inside = inside and global(d) < extent[d];
+						if (inside)
+							return;
+						advance();
+					}
+				}
+				void advance()
+				{
+					++_pos;
+					for (unsigned d = D; d-- > 0;) {
+						if (++_local[d] < B)
+							return;
+						_local[d] = 0;
+					}
+					for (unsigned d = D; d-- > 0;) {
+						if (++_tile[d] < tiles_per[d])
+							return;
+						_tile[d] = 0;
+					}
+				}
+
+			public:
+				basic_iterator(Grid& g, position_t pos)
+					: _grid(&g)
+					, _pos(pos)
+				{
+					position_t tile = pos / tile_cells, local = pos % tile_cells;
+					for (unsigned d = D; d-- > 0;) {
+						_tile[d] = (unsigned)(tile % tiles_per[d]);
+						tile /= tiles_per[d];
+						_local[d] = (unsigned)(local % B);
+						local /= B;
+					}
+					settle();
+				}
+
+				inline operator position_t() const { return _pos; }
+				inline Reference operator*() const { return (*_grid)[_pos]; }
+				inline Reference operator[](offset_t offset) const { return (*_grid)[_pos + offset]; }
+
+			private:
+				// the position class of the cell in every dimension
+				inline std::array<unsigned, D> position_classes() const
+				{
+					std::array<unsigned, D> k{};
+					for (unsigned d = 0; d < D; ++d) {
+						const unsigned l = _local[d], g = global(d);
+						if (g < R)
+							k[d] = 1 + 2 * R + g;
+						else if (g + R >= extent[d])
+							k[d] = 1 + 3 * R + (extent[d] - 1 - g);
+						else if (l < R)
+							k[d] = 1 + l;
+						else if (l + R >= B)
+							k[d] = 1 + R + (B - 1 - l);
+					}
+					return k;
+				}
+
+			public:
+				// the storage offsets of the cell's neighbors: the shared table away from the tile's faces,
+				// otherwise summed up from the steps of the cell's position class in every dimension
+				neighborhood neighbors_offsets() const
+				{
+					constexpr unsigned W = 2 * R + 1;
+					const std::array<unsigned, D> k = position_classes();
+					if (k == std::array<unsigned, D>{})
+						return tile_interior;
+
+					// the box, expanded one dimension at a time from the outermost, and the cells in it
+					const face_steps& s = steps();
+					std::array<offset_t, N> box;
+					std::array<bool, N> valid;
+					box[0] = 0;
+					valid[0] = true;
+					for (std::size_t d = 0, n = 1; d < D; ++d, n *= W)
+						for (std::size_t j = n; j-- > 0;) {
+							const offset_t base = box[j];
+							const bool ok = valid[j];
+							for (unsigned i = W; i-- > 0;) {
+								box[j * W + i] = base + s.step[d][k[d]][i];
+								valid[j * W + i] = ok and s.inside[d][k[d]][i];
+							}
+						}
+					neighborhood hood;
+					for (std::size_t b = 0; b < N; ++b) {
+						bool listed = not valid[b] or box[b] == 0;
+						if (aliased()) // short wrapped dimensions reach cells more than once
+							for (std::size_t i = 0; i < hood.count and not listed; ++i)
+								listed = hood.offsets[i] == box[b];
+						if (not listed)
+							hood.offsets[hood.count++] = box[b];
+					}
+					return hood;
+				}
+				// the number of neighbors, counted from the steps that stay in the space
+				inline position_t size() const
+				{
+					if (aliased())
+						return neighbors_offsets().size();
+					const std::array<unsigned, D> k = position_classes();
+					position_t count = 1;
+					for (unsigned d = 0; d < D; ++d) {
+						position_t in = 0;
+						for (bool inside : steps().inside[d][k[d]])
+							in += inside;
+						count *= in;
+					}
+					return count - 1;
+				}
+
+				// the neighbors, in a view that owns the offsets
+				inline neighbor_view<basic_iterator, neighborhood, true> neighbors() const
+				{
+					return neighbor_view<basic_iterator, neighborhood, true>(*this, neighbors_offsets());
+				}
+
+				inline basic_iterator& operator++()
+				{
+					advance();
+					settle();
+					return *this;
+				}
+				inline bool operator!=(const basic_iterator& rhs) const { return !(*this == rhs); }
+				inline bool operator==(const basic_iterator& rhs) const { return _pos == rhs._pos; }
+				inline unsigned coordinate(unsigned c) const { return global(D - 1 - c); }
+			};
+
+		public:
+			typedef basic_iterator<tiled_grid, reference> iterator;
+			typedef basic_iterator<const tiled_grid, const_reference> const_iterator;
+
+			tiled_grid()
+				: data(storage_size())
+			{
+			}
+			tiled_grid(T _default)
+				: data(storage_size(), _default)
+			{
+			}
+
+			static inline std::string info() { return iterable_space<wrap, R, XX...>::info() + " tiled" + std::to_string(B); }
+
+			// the cells of the space, and the padded storage
+			inline static constexpr position_t size() { return iterable_space<wrap, R, XX...>::size(); }
+			inline static constexpr position_t storage_size() { return tiles() * tile_cells; }
+			inline static constexpr position_t tiles() { return (position_t(1) * ... * position_t((XX + B - 1) / B)); }
+
+			inline static constexpr position_t dimension() { return D; }
+			inline static constexpr position_t dimension(unsigned d) { return iterable_space<wrap, R, XX...>::dimension(d); }
+
+			// the storage position of the coordinates, outermost first
+			template <typename... CC>
+			static inline position_t index(CC... cc)
+			{
+				static_assert(sizeof...(CC) == D);
+				const std::array<unsigned, D> c{ { static_cast<unsigned>(cc)... } };
+				for (unsigned d = 0; d < D; ++d)
+					assert(c[d] < extent[d]);
+				return address(c);
+			}
+
+			inline reference operator[](position_t pos) { return data[pos]; }
+			inline const_reference operator[](position_t pos) const { return data[pos]; }
+
+			template <typename... CC>
+			inline reference operator()(CC... cc) { return data[index(cc...)]; }
+			template <typename... CC>
+			inline const_reference operator()(CC... cc) const { return data[index(cc...)]; }
+
+			inline iterator begin() { return iterator(*this, 0); }
+			inline iterator end() { return iterator(*this, storage_size()); }
+			inline const_iterator begin() const { return const_iterator(*this, 0); }
+			inline const_iterator end() const { return const_iterator(*this, storage_size()); }
+
+			inline iterator tile_begin(position_t t) { return iterator(*this, t * tile_cells); }
+			inline iterator tile_end(position_t t) { return iterator(*this, (t + 1) * tile_cells); }
+			inline const_iterator tile_begin(position_t t) const { return const_iterator(*this, t * tile_cells); }
+			inline const_iterator tile_end(position_t t) const { return const_iterator(*this, (t + 1) * tile_cells); }
+
+			template <typename... CC>
+			inline iterator at(CC... cc) { return iterator(*this, index(cc...)); }
+			template <typename... CC>
+			inline const_iterator at(CC... cc) const { return const_iterator(*this, index(cc...)); }
+
+			inline storage_type& storage() { return data; }
+			inline const storage_type& storage() const { return data; }
+
+			friend void swap(tiled_grid& lhs, tiled_grid& rhs) noexcept { lhs.data.swap(rhs.data); }
+
+			inline bool operator!=(const tiled_grid& oth) const { return !(*this == oth); }
+			inline bool operator==(const tiled_grid& oth) const { return data == oth.data; }
+		};
+
+	} // namespace hyper
+} // namespace sprogar
+
+#endif
@@ -25,10 +25,13 @@
 
 /*
  * GCC:
- * $ g++ -std=c++11 main.cpp examples/game-of-life.cpp test/test.cpp
+ * $ g++ -std=c++17 -pthread main.cpp examples/game-of-life.cpp test/test.cpp
+ *
+ * CMake:
+ * $ cmake -S . -B build && cmake --build build && ctest --test-dir build
  * 
  * Other environments of choice:
- * Create a Console project/App, add all three .cpp files, check the c++11 flag and compile
+ * Create a Console project/App, add all three .cpp files, check the c++17 flag and compile
  *
  * */
 int main()
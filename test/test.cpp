@@ -22,8 +22,24 @@
 #include <iostream>
 #include <vector>
 #include <array>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <bitset>
 
 #include "../include/hyper.h"
+#include "../include/engine.h"
+#include "../include/hashlife.h"
+#include "../include/recorder.h"
+#include "../include/allocator.h"
+#include "../include/soa.h"
+#include "../include/morton.h"
+#include "../include/tiled.h"
+#ifndef _WIN32
+#include "../include/storage.h"
+#include "../include/snapshot.h"
+#include "../include/partition.h"
+#endif
 
 namespace sprogar {
 	namespace test {
@@ -140,6 +156,27 @@ namespace sprogar {
 			assert(0 == it[2]);
 			assert(4 == it);
 		},
+		[]() {
+			std::clog << "incremental neighborhood type test\n";
+			// a digit in base 2R+1 per dimension, the innermost dimension being the least significant
+			typedef location_iterator<2/*R*/, 6, 5, 7> loc;
+			const unsigned R = 2, extent[] = { 7, 5, 6 }; // innermost first
+			auto expected = [&](const loc& it) {
+				unsigned typ = 0, weight = 1;
+				for (unsigned d = 0; d < 3; weight *= 2 * R + 1, ++d) {
+					const unsigned c = it[d], X = extent[d];
+					typ += (c < R ? 1 + c : c + R >= X ? 2 * R - (X - 1 - c) : 0) * weight;
+				}
+				return typ;
+			};
+			loc it;
+			for (position_t pos = 0; pos + 1 < loc::size(); ++pos, ++it)
+				assert(it.type() == expected(it));
+			for (position_t pos = loc::size() - 1; pos > 0; --pos, --it)
+				assert(it.type() == expected(it));
+			assert(it == 0 and it.type() == expected(it) and it.type() == 1 + 1 * 5 + 1 * 25);
+			assert(loc(5, 4, 6).type() == 4 + 4 * 5 + 4 * 25 and loc(3, 2, 3).type() == 0);
+		},
 		[]() {
 			std::clog << "null spc neighbor offset test\n";
 			wrapped_space<bool, 1/*R*/, 0> ws;
@@ -186,6 +223,15 @@ namespace sprogar {
 			assert(it.neighbors_offsets() == std::vector<offset_t>({ 1, 2, 5, 6, 7, 8, 9, 12, 13, 14, 15, 16,
 				19, 20, 266, 267, 268, 271, 272, 273, 274, 275, 278, 279 }));
 		},
+		[]() {
+			std::clog << "compile-time offsets test\n";
+			typedef unwrapped_space_offsets<1/*R*/, 3, 3> spc;
+			static_assert(spc::neighbors_offsets(0).size() == 8, "center");
+			static_assert(spc::neighbors_offsets(0)[0] == -4 and spc::neighbors_offsets(0)[7] == 4, "center");
+			static_assert(spc::neighbors_offsets(1 + 3).size() == 3, "corner");
+			assert(spc::begin().type() == 1 + 3);
+			assert(spc::neighbors_offsets(0) == std::vector<offset_t>({ -4, -3, -2, -1, 1, 2, 3, 4 }));
+		},
 		[]() {
 			std::clog << "crosscheck test\n";
 			unwrapped_space<bool, 1/*R*/, 2, 4> uws;
@@ -636,20 +682,1352 @@ namespace sprogar {
 			assert(*it == std::make_pair(0, 0));
 		},
 		[]() {
-			// "ISSUE #1: failure to auto-deduce the type stored in the neighboring cells\n";
-			// hyper::unwrapped_space<int, 1/*R*/, 5> spc;
-			// auto cell = spc.at(2);
-			// 
-			// for(auto& x : cell.neighbors())
-			//     x = 42;  // compile error
-			},
-		[]() {
-			// "ISSUE #2: vector<reference_wrapper<bool>> problem with range-for syntax\n";
-			// hyper::unwrapped_space<bool, 1/*R*/, 5> spc;
-			// auto cell = spc.at(2);
-			//
-			// for(bool& x : cell.neighbors())    // compile error
-			//    x = true;
+			std::clog << "interior and boundary traversal test\n";
+			unwrapped_space<int, 1/*R*/, 4, 5> spc{ 0 };
+			typedef unwrapped_space<int, 1/*R*/, 4, 5>::iterator iterator;
+
+			int interior = 0;
+			spc.for_each_interior([&](iterator it, const unwrapped_space<int, 1/*R*/, 4, 5>::space_offsets::neighborhood& hood) {
+				assert(it.type() == 0);
+				assert(hood.size() == 8);
+				*it += 1;
+				interior += 1;
+			});
+			int boundary = 0;
+			spc.for_each_boundary([&](iterator it, const unwrapped_space<int, 1/*R*/, 4, 5>::space_offsets::neighborhood& hood) {
+				assert(it.type() != 0);
+				assert(hood.size() == it.size());
+				*it += 1;
+				boundary += 1;
+			});
+			assert(interior == 2 * 3);
+			assert(boundary == 4 * 5 - 2 * 3);
+			for (int x : spc)
+				assert(x == 1);
+		},
+		[]() {
+			std::clog << "boundary traversal of a thin space test\n";
+			const wrapped_space<int, 2/*R*/, 3, 9> spc{ 1 };
+			int interior = 0, boundary = 0;
+			spc.for_each_interior([&](wrapped_space<int, 2/*R*/, 3, 9>::const_iterator, const auto&) { interior += 1; });
+			spc.for_each_boundary([&](wrapped_space<int, 2/*R*/, 3, 9>::const_iterator it, const auto& hood) {
+				int sum = 0;
+				for (auto off : hood)
+					sum += it[off];
+				assert(sum == 3 * 5 - 1);
+				boundary += *it;
+			});
+			assert(interior == 0);
+			assert(boundary == 3 * 9);
+		},
+		[]() {
+			std::clog << "split traversal crosscheck 3-D test\n";
+			typedef unwrapped_space<int, 1/*R*/, 4, 5, 6> spc;
+			spc values([]() {
+				static int i = 0;
+				return i++ % 7;
+			});
+			spc sums{ 0 }, split_sums{ 0 };
+
+			for (auto it = values.begin(); it != values.end(); ++it)
+				for (auto off : it)
+					sums[it] += it[off];
+
+			auto sum = [&](spc::iterator it, const spc::space_offsets::neighborhood& hood) {
+				for (auto off : hood)
+					split_sums[it] += it[off];
+			};
+			values.for_each_interior(sum);
+			values.for_each_boundary(sum);
+			assert(sums == split_sums);
+		},
+		[]() {
+			std::clog << "halo grid access test\n";
+			halo_grid<int, 2/*R*/, 3, 4> spc{ 0 };
+			spc(1, 2) = 42;
+			assert(spc.size() == 3 * 4);
+			assert(spc[(1 + 2) * 8 + 2 + 2] == 42);
+			assert(*spc.at(1, 2) == 42);
+			assert(spc.neighbors_offsets().size() == 24);
+			assert((halo_grid<int, 2/*R*/, 3, 4>::info()) == "3x4 unwrapped R2 halo");
+
+			int cells = 0;
+			spc.for_each([&](halo_grid<int, 2/*R*/, 3, 4>::iterator it, const halo_grid<int, 2/*R*/, 3, 4>::neighborhood& hood) {
+				assert(&hood == &spc.neighbors_offsets());
+				cells += 1 + *it;
+			});
+			assert(cells == 3 * 4 + 42);
+		},
+		[]() {
+			std::clog << "halo grid boundary fill test\n";
+			halo_grid<int, 2/*R*/, 5> spc{ 0 };
+			for (int i = 0; i < 5; ++i)
+				spc(i) = i;
+
+			spc.fill_halo(-1);
+			assert(spc[0] == -1 and spc[1] == -1 and spc[7] == -1 and spc[8] == -1);
+
+			spc.fill_halo(periodic());
+			assert(spc[0] == 3 and spc[1] == 4 and spc[7] == 0 and spc[8] == 1);
+
+			spc.fill_halo(reflective());
+			assert(spc[0] == 1 and spc[1] == 0 and spc[7] == 4 and spc[8] == 3);
+			for (int i = 0; i < 5; ++i)
+				assert(spc(i) == i);
+
+			// a constant of another type than the cells is a value, not a boundary condition
+			halo_grid<bool, 1/*R*/, 4, 3> flags(false);
+			flags.fill_halo(1);
+			assert(flags[0] and not flags(0, 0));
+		},
+		[]() {
+			std::clog << "halo grid matches wrapped and unwrapped spaces test\n";
+			typedef halo_grid<int, 1/*R*/, 4, 5, 6> halo;
+			typedef wrapped_space<int, 1/*R*/, 4, 5, 6> wrapped;
+			typedef unwrapped_space<int, 1/*R*/, 4, 5, 6> unwrapped;
+			wrapped values([]() {
+				static int i = 0;
+				return i++ % 11;
+			});
+			halo h{ 0 };
+			for (auto it = values.begin(); it != values.end(); ++it)
+				h(it.coordinate(2), it.coordinate(1), it.coordinate(0)) = *it;
+
+			auto sums = [](const halo& g) {
+				wrapped ans{ 0 };
+				g.for_each([&](halo::const_iterator it, const halo::neighborhood& hood) {
+					for (auto off : hood)
+						ans(it.coordinate(2) - 1, it.coordinate(1) - 1, it.coordinate(0) - 1) += it[off];
+				});
+				return ans;
+			};
+			wrapped wrapped_sums{ 0 };
+			unwrapped unwrapped_values{ 0 }, unwrapped_sums{ 0 };
+			for (auto it = values.begin(); it != values.end(); ++it) {
+				unwrapped_values[it] = *it;
+				for (auto off : it)
+					wrapped_sums[it] += it[off];
+			}
+			for (auto it = unwrapped_values.begin(); it != unwrapped_values.end(); ++it)
+				for (auto off : it)
+					unwrapped_sums[it] += it[off];
+
+			h.fill_halo(periodic());
+			assert(sums(h) == wrapped_sums);
+
+			h.fill_halo(0);
+			wrapped ans = sums(h);
+			for (position_t pos = 0; pos < wrapped::size(); ++pos)
+				assert(ans[pos] == unwrapped_sums[pos]);
+		},
+		[]() {
+			std::clog << "bit grid access test\n";
+			bit_grid<1/*R*/, false, 3, 70> spc(true);
+			assert(spc.words().size() == 3 * 2);
+			assert(spc.words()[1] == (1ULL << 6) - 1);
+			spc(1, 65) = false;
+			assert(not spc(1, 65));
+			assert(not spc[70 + 65]);
+			assert(spc(1, 64) and spc(1, 66));
+
+			int living = 0;
+			for (auto b : spc)
+				living += b;
+			assert(living == 3 * 70 - 1);
+
+			auto it = spc.at(1, 64);
+			int neighbors = 0;
+			for (auto off : it)
+				neighbors += it[off];
+			assert(neighbors == 7);
+			it[1] = true;
+			assert(spc(1, 65));
+		},
+		[]() {
+			std::clog << "bit grid kernel crosscheck test\n";
+			auto crosscheck = [](auto spc, bool (*rule)(int, bool)) {
+				auto next = spc, expected = spc;
+				for (int step = 0; step < 6; ++step) {
+					for (auto it = spc.begin(); it != spc.end(); ++it) {
+						int living_neighbors = 0;
+						for (auto off : it)
+							living_neighbors += it[off];
+						expected[it] = rule(living_neighbors, *it);
+					}
+					spc.step(next, rule);
+					assert(next == expected);
+					swap(spc, next);
+				}
+			};
+			auto random = []() {
+				static unsigned seed = 1;
+				seed = seed * 1103515245 + 12345;
+				return (seed >> 16) % 3 == 0;
+			};
+			auto conway = [](int count, bool alive) { return count == 3 or (alive and count == 2); };
+			auto parity = [](int count, bool alive) { return (count + alive) % 2 == 1; };
+
+			crosscheck(bit_grid<1/*R*/, true, 5, 10>(random), conway);
+			crosscheck(bit_grid<1/*R*/, false, 5, 10>(random), conway);
+			crosscheck(bit_grid<1/*R*/, true, 7, 130>(random), parity);
+			crosscheck(bit_grid<1/*R*/, false, 4, 128>(random), parity);
+			crosscheck(bit_grid<1/*R*/, true, 2, 5, 10>(random), parity);
+			crosscheck(bit_grid<1/*R*/, false, 3, 4, 70>(random), parity);
+			crosscheck(bit_grid<1/*R*/, true, 3, 2>(random), parity);
+			crosscheck(bit_grid<1/*R*/, true, 1, 3, 1>(random), parity);
+			crosscheck(bit_grid<1/*R*/, false, 2, 2>(random), parity);
+			crosscheck(bit_grid<1/*R*/, true, 64>(random), parity);
+			crosscheck(bit_grid<1/*R*/, true, 3, 3, 3, 65>(random), parity);
+		},
+		[]() {
+			std::clog << "bit grid glider test\n";
+			bit_grid<1/*R*/, true, 5, 10> grid(false), next(false);
+			grid(0, 1) = grid(1, 2) = grid(2, 0) = grid(2, 1) = grid(2, 2) = true;
+			const auto initial(grid);
+
+			int iterations = 0;
+			do {
+				grid.step(next, [](int count, bool alive) { return count == 3 or (alive and count == 2); });
+				swap(grid, next);
+				iterations += 1;
+			} while (initial != grid);
+			assert(iterations == 40);
+		},
+		[]() {
+			std::clog << "stencil engine glider test\n";
+			wrapped_space<bool, 1/*R*/, 5, 10> grid(false);
+			grid(0, 1) = grid(1, 2) = grid(2, 0) = grid(2, 1) = grid(2, 2) = true;
+
+			stencil_engine<wrapped_space<bool, 1/*R*/, 5, 10>> engine(grid, 3);
+			assert(engine.threads() == 3);
+			int iterations = 0;
+			do {
+				engine.step(1, [](bool alive, auto neighbors) {
+					int count = 0;
+					for (bool x : neighbors)
+						count += x;
+					return count == 3 or (alive and count == 2);
+				});
+				iterations += 1;
+			} while (engine.state() != grid);
+			assert(iterations == 40);
+		},
+		[]() {
+			std::clog << "stencil engine crosscheck test\n";
+			typedef unwrapped_space<int, 1/*R*/, 7, 4, 5> spc;
+			spc g([]() {
+				static int i = 0;
+				return i++ % 10;
+			});
+			auto rule = [](int cell, auto neighbors) {
+				int sum = cell;
+				for (int x : neighbors)
+					sum += x;
+				return sum % 10;
+			};
+
+			stencil_engine<spc> serial(g, 1), parallel(g, 4), crowded(g, 9);
+			serial.step(5, rule);
+			parallel.step(2, rule);
+			parallel.step(3, rule);
+			crowded.step(5, rule);
+
+			spc expected(g), next(g);
+			for (int s = 0; s < 5; ++s) {
+				for (auto it = expected.begin(); it != expected.end(); ++it) {
+					int sum = *it;
+					for (auto off : it)
+						sum += it[off];
+					next[it] = sum % 10;
+				}
+				swap(expected, next);
+			}
+			assert(serial.state() == expected);
+			assert(parallel.state() == expected);
+			assert(crowded.state() == expected);
+
+			// a throwing rule, on the calling thread or in the pool, leaves step() by the exception
+			const std::thread::id caller = std::this_thread::get_id();
+			for (bool on_caller : { true, false }) {
+				stencil_engine<spc> engine(g, 4);
+				auto failing = [&](int cell, auto neighbors) {
+					if ((std::this_thread::get_id() == caller) == on_caller)
+						throw std::runtime_error("rule failed");
+					return rule(cell, neighbors);
+				};
+				unsigned thrown = 0;
+				try {
+					engine.step(3, failing);
+				}
+				catch (const std::runtime_error&) {
+					thrown += 1;
+				}
+				try {
+					engine.step_blocked(3, 2, failing);
+				}
+				catch (const std::runtime_error&) {
+					thrown += 1;
+				}
+				assert(thrown == 2);
+				engine.step(1, rule); // the workers are still in step
+			}
+		},
+		[]() {
+			std::clog << "stencil engine packed booleans test\n";
+			typedef unwrapped_space<bool, 1/*R*/, 9, 40> bools;
+			typedef bit_grid<1/*R*/, false, 9, 40> bits;
+			auto random = []() {
+				static unsigned seed = 7;
+				seed = seed * 1103515245 + 12345;
+				return (seed >> 16) % 3 == 0;
+			};
+			bools b(random);
+			bits p;
+			for (position_t pos = 0; pos < bools::size(); ++pos)
+				p[pos] = b[pos];
+
+			auto rule = [](bool alive, auto neighbors) {
+				int count = 0;
+				for (bool x : neighbors)
+					count += x;
+				return count == 3 or (alive and count == 2);
+			};
+			stencil_engine<bools> bool_engine(b, 4);
+			stencil_engine<bits> bit_engine(p, 4);
+			bool_engine.step(20, rule);
+			bit_engine.step(20, rule);
+
+			bits expected(p), next;
+			for (int s = 0; s < 20; ++s) {
+				expected.step(next, [](int count, bool alive) { return count == 3 or (alive and count == 2); });
+				swap(expected, next);
+			}
+			assert(bit_engine.state() == expected);
+			for (position_t pos = 0; pos < bools::size(); ++pos)
+				assert(bool_engine.state()[pos] == expected[pos]);
+		},
+		[]() {
+			std::clog << "temporal blocking test\n";
+			auto random = []() {
+				static unsigned seed = 3;
+				seed = seed * 1103515245 + 12345;
+				return (int)((seed >> 16) % 4);
+			};
+			// depends on the number of neighbors, hence on the neighborhood types
+			auto rule = [](int cell, auto neighbors) {
+				int sum = 0;
+				for (int x : neighbors)
+					sum += x;
+				return (cell + 2 * sum + (int)neighbors.size()) % 5;
+			};
+			auto crosscheck = [&](auto initial) {
+				for (unsigned threads : { 1, 3 })
+					for (unsigned k : { 1, 2, 3, 5 })
+						for (position_t tile_rows : { 0, 1, 2, 7 }) {
+							stencil_engine<decltype(initial)> plain(initial, threads), blocked(initial, threads);
+							plain.step(11, rule);
+							blocked.step_blocked(11, k, rule, tile_rows);
+							assert(plain.state() == blocked.state());
+						}
+			};
+			crosscheck(wrapped_space<int, 1/*R*/, 13, 6>(random));
+			crosscheck(unwrapped_space<int, 1/*R*/, 13, 6>(random));
+			crosscheck(wrapped_space<int, 2/*R*/, 9, 4, 5>(random));
+			crosscheck(unwrapped_space<int, 2/*R*/, 9, 4, 5>(random));
+			crosscheck(wrapped_space<int, 1/*R*/, 2, 8>(random));
+			crosscheck(wrapped_space<int, 1/*R*/, 17>(random));
+			crosscheck(unwrapped_space<int, 2/*R*/, 17>(random));
+			crosscheck(bit_grid<1/*R*/, false, 12, 70>());
+		},
+		[]() {
+			std::clog << "incremental engine test\n";
+			auto life = [](bool alive, auto neighbors) {
+				int count = 0;
+				for (bool x : neighbors)
+					count += x;
+				return count == 3 or (alive and count == 2);
+			};
+			typedef wrapped_space<bool, 1/*R*/, 20, 30> space;
+			space initial(false);
+			initial(1, 1) = initial(1, 2) = initial(2, 1) = initial(2, 2) = true; // block
+			initial(10, 11) = initial(11, 12) = initial(12, 10) = initial(12, 11) = initial(12, 12) = true; // glider
+
+			incremental_engine<space> sparse(initial);
+			stencil_engine<space> dense(initial, 1);
+			for (int s = 0; s < 50; ++s) {
+				sparse.step(1, life);
+				dense.step(1, life);
+				assert(sparse.state() == dense.state());
+				assert(s == 0 or sparse.active_cells() < 60);
+			}
+
+			// external changes wake up their neighborhood
+			sparse.assign(space::space_offsets::iterator(5, 20), true);
+			assert(sparse.state()(5, 20));
+			sparse.step(1, life);
+			assert(not sparse.state()(5, 20));
+
+			space block(false);
+			block(5, 5) = block(5, 6) = block(6, 5) = block(6, 6) = true;
+			incremental_engine<space> still(block);
+			still.step(1, life);
+			assert(still.active_cells() == 0 and still.state() == block);
+		},
+		[]() {
+			std::clog << "incremental engine 3D test\n";
+			auto rule = [](int cell, auto neighbors) {
+				int sum = 0;
+				for (int x : neighbors)
+					sum += x;
+				return sum == 1 or sum == 2 ? (cell + sum) % 3 : 0;
+			};
+			auto crosscheck = [&](auto initial) {
+				incremental_engine<decltype(initial)> sparse(initial);
+				stencil_engine<decltype(initial)> dense(initial, 2);
+				for (int s = 0; s < 12; ++s) {
+					sparse.step(1, rule);
+					dense.step(1, rule);
+					assert(sparse.state() == dense.state());
+				}
+				sparse.step(5, rule);
+				dense.step(5, rule);
+				assert(sparse.state() == dense.state());
+			};
+			unwrapped_space<int, 1/*R*/, 9, 10, 11> u(0);
+			u(4, 5, 5) = u(0, 0, 0) = u(8, 9, 10) = 1;
+			crosscheck(u);
+			wrapped_space<int, 2/*R*/, 7, 8, 9> w(0);
+			w(3, 3, 3) = w(0, 7, 8) = 2;
+			crosscheck(w);
+		},
+		[]() {
+			std::clog << "hashlife test\n";
+			auto conway = [](int count, bool alive) { return count == 3 or (alive and count == 2); };
+			auto reference = [&](auto initial, unsigned generations) {
+				stencil_engine<decltype(initial)> engine(initial, 1);
+				engine.step(generations, [&](bool alive, auto neighbors) {
+					int count = 0;
+					for (bool x : neighbors)
+						count += x;
+					return conway(count, alive);
+				});
+				return engine.state();
+			};
+
+			typedef wrapped_space<bool, 1/*R*/, 16, 16> torus;
+			torus glider(false);
+			glider(0, 1) = glider(1, 2) = glider(2, 0) = glider(2, 1) = glider(2, 2) = true;
+			hashlife<true, 16, 16> life(glider, conway);
+			life.step(1);
+			assert(life.state() == reference(glider, 1));
+			life.step(36);
+			assert(life.state() == reference(glider, 37));
+			life.step(27); // the glider crosses the torus in 64 generations
+			assert(life.state() == glider);
+			life.step(1000000000ULL - 64);
+			assert(life.generation() == 1000000000ULL and life.state() == glider);
+
+			auto random = []() {
+				static unsigned seed = 11;
+				seed = seed * 1103515245 + 12345;
+				return (seed >> 16) % 3 == 0;
+			};
+			unwrapped_space<bool, 1/*R*/, 10, 13> box(random);
+			hashlife<false, 10, 13> boxed(box, conway);
+			for (unsigned generations : { 1, 2, 5, 8, 16 }) {
+				boxed.step(generations);
+				assert(boxed.state() == reference(box, (unsigned)boxed.generation()));
+			}
+
+			// the tables are collected and rebuilt without changing the results
+			hashlife<false, 10, 13> bounded(box, conway, 200);
+			for (unsigned generations : { 3, 7, 12, 25 }) {
+				bounded.step(generations);
+				assert(bounded.state() == reference(box, (unsigned)bounded.generation()));
+			}
+			const std::size_t grown = bounded.node_count();
+			bounded.clear_cache();
+			assert(bounded.node_count() < grown);
+			assert(bounded.state() == reference(box, 47));
+			bounded.step(3);
+			assert(bounded.state() == reference(box, 50));
+		},
+		[]() {
+			std::clog << "hashlife 3D test\n";
+			auto rule = [](int count, bool alive) { return alive ? count >= 4 and count <= 6 : count == 5; };
+			auto reference = [&](auto initial, unsigned generations) {
+				stencil_engine<decltype(initial)> engine(initial, 2);
+				engine.step(generations, [&](bool alive, auto neighbors) {
+					int count = 0;
+					for (bool x : neighbors)
+						count += x;
+					return rule(count, alive);
+				});
+				return engine.state();
+			};
+			auto random = []() {
+				static unsigned seed = 5;
+				seed = seed * 1103515245 + 12345;
+				return (seed >> 16) % 4 == 0;
+			};
+			wrapped_space<bool, 1/*R*/, 4, 8, 8> torus(random);
+			hashlife<true, 4, 8, 8> wrapped(torus, rule);
+			unwrapped_space<bool, 1/*R*/, 5, 6, 7> box(random);
+			hashlife<false, 5, 6, 7> unwrapped(box, rule);
+			for (unsigned generations : { 1, 3, 4, 9 }) {
+				wrapped.step(generations);
+				unwrapped.step(generations);
+				assert(wrapped.state() == reference(torus, (unsigned)wrapped.generation()));
+				assert(unwrapped.state() == reference(box, (unsigned)unwrapped.generation()));
+			}
+		},
+		[]() {
+			std::clog << "dynamic grid test\n";
+			auto kernel = [](auto& next, const auto& g) {
+				for (auto it = g.begin(); it != g.end(); ++it) {
+					int sum = 0;
+					for (auto off : it)
+						sum += it[off];
+					next[it] = (*it + sum + (int)it.size()) % 7;
+				}
+			};
+			auto crosscheck = [&](auto fixed, std::vector<unsigned> extents, unsigned R, bool wrap) {
+				dynamic_grid<int> dynamic(extents, R, wrap);
+				assert(dynamic.size() == fixed.size() and dynamic.dimension() == fixed.dimension());
+				assert(dynamic.info() == fixed.info());
+				for (unsigned d = 0; d < fixed.dimension(); ++d)
+					assert(dynamic.dimension(d) == fixed.dimension(d));
+
+				position_t pos = 0;
+				for (auto it = fixed.begin(); it != fixed.end(); ++it, ++pos)
+					dynamic[pos] = *it = (int)(pos * 7919 % 5);
+
+				auto d = dynamic.begin();
+				for (auto it = fixed.begin(); it != fixed.end(); ++it, ++d) {
+					assert((unsigned)d == (unsigned)it and d.type() == it.type());
+					assert(std::equal(d.begin(), d.end(), it.begin(), it.end()));
+					for (unsigned c = 0; c < fixed.dimension(); ++c)
+						assert(d.coordinate(c) == it.coordinate(c));
+				}
+				assert(d == dynamic.end());
+				do {
+					--d;
+					assert(dynamic.neighbors_offsets(d.type()).size() == d.size());
+				} while (d != dynamic.begin());
+
+				auto fixed_next = fixed;
+				auto dynamic_next = dynamic;
+				for (int s = 0; s < 3; ++s) {
+					kernel(fixed_next, fixed);
+					kernel(dynamic_next, dynamic);
+					swap(fixed, fixed_next);
+					swap(dynamic, dynamic_next);
+				}
+				for (pos = 0; pos < fixed.size(); ++pos)
+					assert(dynamic[pos] == fixed[pos]);
+			};
+			crosscheck(unwrapped_space<int, 1/*R*/, 5, 7>(), { 5, 7 }, 1, false);
+			crosscheck(wrapped_space<int, 1/*R*/, 5, 7>(), { 5, 7 }, 1, true);
+			crosscheck(wrapped_space<int, 2/*R*/, 3, 6, 4>(), { 3, 6, 4 }, 2, true);
+			crosscheck(unwrapped_space<int, 2/*R*/, 2, 6, 9>(), { 2, 6, 9 }, 2, false);
+			crosscheck(wrapped_space<int, 1/*R*/, 11>(), { 11 }, 1, true);
+
+			dynamic_grid<int> g({ 4, 5, 6 }, 1, false, 3);
+			g(1, 2, 3) = 42;
+			assert(g.at(1, 2, 3).coordinate(0) == 3 and g.at(1, 2, 3).coordinate(2) == 1);
+			assert(*g.at(1, 2, 3) == 42 and g[(1 * 5 + 2) * 6 + 3] == 42 and g[0] == 3);
+			for (auto it = g.begin(); it != g.end(); ++it) {
+				auto by_coordinates = g.at(it.coordinate(2), it.coordinate(1), it.coordinate(0));
+				assert(by_coordinates == it and by_coordinates.type() == it.type());
+			}
+			dynamic_grid<int> h(g.space(), 0);
+			assert(h.space() == g.space() and h != g);
+
+			// the same cells in another shape
+			dynamic_grid<int> flat({ 4, 30 }, 1, false, 3), other({ 4, 5, 6 }, 1, false, 3);
+			flat(1, 13) = 42;
+			assert(flat != g and other != g);
+			other(1, 2, 3) = 42;
+			assert(other == g and other.space() != g.space());
+
+			// shapes and coordinates come from run-time input and are checked as such
+			auto throws = [](auto f) {
+				try {
+					f();
+				} catch (const std::logic_error&) {
+					return true;
+				}
+				return false;
+			};
+			assert(throws([]() { dynamic_space({}, 1, false); }));
+			assert(throws([]() { dynamic_space(std::vector<unsigned>(dynamic_space::max_dimension + 1, 2), 1, false); }));
+			assert(throws([]() { dynamic_space({ 9, 9, 9 }, 1u << 31, true); }));
+			assert(throws([]() { dynamic_space({ 1u << 31, 1u << 31, 1u << 31 }, 0, false); }));
+			assert(throws([&]() { g(1, 2); }));
+			assert(throws([&]() { g(1, 5, 3); }));
+			assert(throws([&]() { g.at(-1, 2, 3); }));
+			assert(not throws([&]() { g(3, 4, 5); }));
+		},
+		[]() {
+			std::clog << "64-bit positions test\n";
+			typedef location_iterator<1/*R*/, 3000, 3000, 1000> huge;
+			static_assert(huge::size() == 9000000000ULL);
+			const position_t last = huge::size() - 1;
+
+			huge it(last);
+			assert(it[2] == 2999 and it[1] == 2999 and it[0] == 999 and (position_t)it == last);
+			huge c(2999, 2999, 999);
+			assert((position_t)c == last and c.type() == it.type());
+			--it;
+			assert(it[0] == 998 and (position_t)it == last - 1 and it.type() == 2 * 9 + 2 * 3 + 0);
+
+			typedef wrapped_space_offsets<1/*R*/, 3000, 3000, 1000> offsets;
+			static_assert(offsets::size() == huge::size());
+			assert(offsets::id(2999, 2999, 999) == last);
+			// the first neighbor wraps around the outer two dimensions
+			assert(offsets::neighbors_offsets(it.type())[0] == -(offset_t)(2999ULL * 3000 * 1000 + 2999 * 1000 + 1));
+
+			wrapped_space<int, 1/*R*/, 4, 5> small;
+			position_t pos = small.at(3, 4);
+			assert(pos == small.size() - 1);
+		},
+#ifndef _WIN32
+		[]() {
+			std::clog << "mapped storage test\n";
+			typedef wrapped_space<int, 1/*R*/, 6, 9, 7> memory;
+			typedef mapped_grid<int, 1/*R*/, true, 6, 9, 7> mapped;
+			const std::string path = "hyperspace-mapped-test.bin";
+			std::remove(path.c_str());
+
+			auto kernel = [](auto& next, const auto& g) {
+				for (auto it = g.begin(); it != g.end(); ++it) {
+					int sum = 0;
+					for (auto off : it)
+						sum += it[off];
+					next[it] = (*it + sum) % 9;
+				}
+			};
+			// generated cells: appended to a vector, assigned to anonymous mapped storage
+			auto seven = []() { return 7; };
+			assert(memory(+seven) == memory(7) and mapped(+seven) == mapped(7));
+
+			memory m(0), m_next;
+			{
+				mapped g(mapped_storage<int>(path, mapped::size(), 100 * sizeof(int)));
+				mapped g_next(0);
+				g.storage().advise(mapped_storage<int>::access::sequential);
+				for (position_t pos = 0; pos < mapped::size(); ++pos)
+					g[pos] = m[pos] = (int)(pos * 31 % 9);
+
+				kernel(g_next, g);
+				kernel(g, g_next);
+				kernel(m_next, m);
+				kernel(m, m_next);
+				for (position_t pos = 0; pos < mapped::size(); ++pos)
+					assert(g[pos] == m[pos]);
+				g.storage().sync();
+
+				mapped copy = g; // into anonymous memory
+				assert(copy == g);
+				copy[0] += 1;
+				assert(copy != g);
+			}
+			// reopening the file restores the grid
+			mapped restored(mapped_storage<int>(path, mapped::size(), 100 * sizeof(int)));
+			for (position_t pos = 0; pos < mapped::size(); ++pos)
+				assert(restored[pos] == m[pos]);
+			std::remove(path.c_str());
+		},
+		[]() {
+			std::clog << "snapshot test\n";
+			typedef unwrapped_space<double, 2/*R*/, 5, 300, 7> space;
+			const std::string path = "hyperspace-snapshot-test.bin";
+
+			space g;
+			for (position_t pos = 0; pos < space::size(); ++pos)
+				g[pos] = pos * 0.5;
+			save_snapshot(g, path);
+
+			space loaded(-1.0);
+			load_snapshot(loaded, path);
+			assert(loaded == g);
+
+			auto mapped = map_snapshot<double, 2/*R*/, false, 5, 300, 7>(path);
+			for (position_t pos = 0; pos < space::size(); ++pos)
+				assert(mapped[pos] == g[pos]);
+			mapped(4, 299, 6) = 42;
+			mapped.storage().sync();
+			load_snapshot(loaded, path);
+			assert(loaded(4, 299, 6) == 42 and loaded != g);
+
+			bool rejected = false;
+			try {
+				wrapped_space<double, 2/*R*/, 5, 300, 7> other;
+				load_snapshot(other, path);
+			}
+			catch (const std::runtime_error&) {
+				rejected = true;
+			}
+			assert(rejected);
+
+			// a private mapping, as of a read-only snapshot, keeps the changes in memory
+			{
+				mapped_storage<double> copy(path, space::size(), 4096, mapped_storage<double>::mapping::private_copy);
+				assert(copy[1] == g[1]);
+				copy[1] = -5;
+				copy.sync();
+			}
+			load_snapshot(loaded, path);
+			assert(loaded[1] == g[1]);
+
+			// a truncated snapshot is neither loaded nor mapped, and stays truncated
+			const off_t truncated = (off_t)(4096 + space::size() * sizeof(double) - 8);
+			assert(::truncate(path.c_str(), truncated) == 0);
+			unsigned failures = 0;
+			try {
+				load_snapshot(loaded, path);
+			}
+			catch (const std::runtime_error&) {
+				failures += 1;
+			}
+			try {
+				map_snapshot<double, 2/*R*/, false, 5, 300, 7>(path);
+			}
+			catch (const std::runtime_error&) {
+				failures += 1;
+			}
+			struct stat info;
+			assert(failures == 2 and ::stat(path.c_str(), &info) == 0 and info.st_size == truncated);
+			std::remove(path.c_str());
+		},
+		[]() {
+			std::clog << "partitioned grid test\n";
+			auto rule = [](int cell, const auto& neighbors) {
+				int sum = 0;
+				for (int n : neighbors)
+					sum += n;
+				return (cell * 3 + sum) % 11;
+			};
+			auto crosscheck = [&](auto space, unsigned ranks, unsigned steps) {
+				typedef decltype(space) G;
+				for (position_t pos = 0; pos < G::size(); ++pos)
+					space[pos] = (int)(pos * 7 % 11);
+				stencil_engine<G> reference(space, 1);
+				reference.step(steps, rule);
+
+				std::vector<socket_transport> endpoints = socket_transport::mesh(ranks);
+				std::vector<G> gathered(ranks, G(-1));
+				std::vector<std::thread> threads;
+				for (unsigned r = 0; r < ranks; ++r)
+					threads.emplace_back([&, r] {
+						partitioned_grid<G> part(endpoints[r], space);
+						part.step(steps, rule);
+						const auto rows = part.owned_rows();
+						const position_t plane = G::size() / G::dimension(G::dimension() - 1);
+						for (position_t pos = rows.first * plane; pos < rows.second * plane; ++pos)
+							assert(part[pos] == reference.state()[pos]);
+						part.gather(gathered[r]);
+					});
+				for (auto& t : threads)
+					t.join();
+				assert(gathered[0] == reference.state());
+			};
+			crosscheck(wrapped_space<int, 1/*R*/, 12, 10>(), 3, 4);
+			crosscheck(unwrapped_space<int, 1/*R*/, 12, 10>(), 3, 4);
+			crosscheck(wrapped_space<int, 2/*R*/, 9, 5, 7>(), 2, 3);
+			crosscheck(unwrapped_space<int, 2/*R*/, 9, 5, 7>(), 4, 3);
+			crosscheck(wrapped_space<int, 1/*R*/, 9, 8>(), 1, 5);
+
+			// a rule that throws while the halos are in flight leaves step() by the exception
+			std::vector<socket_transport> pair = socket_transport::mesh(2);
+			std::atomic<unsigned> caught{ 0 };
+			std::vector<std::thread> failing;
+			for (unsigned r = 0; r < 2; ++r)
+				failing.emplace_back([&, r] {
+					typedef wrapped_space<int, 1/*R*/, 12, 10> H;
+					partitioned_grid<H> part(pair[r], H(1));
+					unsigned calls = 0;
+					try {
+						part.step(1, [&calls](int cell, const auto&) {
+							if (++calls > 2 * 10) // past the two edge rows
+								throw std::runtime_error("rule failed");
+							return cell;
+						});
+					}
+					catch (const std::runtime_error&) {
+						caught += 1;
+					}
+				});
+			for (auto& t : failing)
+				t.join();
+			assert(caught == 2);
+
+			// a rank that fails alone aborts the transport, so that its peer fails instead of waiting
+			std::vector<socket_transport> lonely = socket_transport::mesh(2);
+			caught = 0;
+			failing.clear();
+			for (unsigned r = 0; r < 2; ++r)
+				failing.emplace_back([&, r] {
+					typedef wrapped_space<int, 1/*R*/, 12, 10> H;
+					partitioned_grid<H> part(lonely[r], H(1));
+					try {
+						part.step(5, [r](int cell, const auto&) {
+							if (r == 0)
+								throw std::runtime_error("rule failed");
+							return cell;
+						});
+					}
+					catch (const std::runtime_error&) {
+						caught += 1;
+					}
+				});
+			for (auto& t : failing)
+				t.join();
+			assert(caught == 2);
+
+			// too many ranks for the radius
+			std::vector<socket_transport> crowd = socket_transport::mesh(5);
+			bool rejected = false;
+			try {
+				partitioned_grid<wrapped_space<int, 2/*R*/, 9, 5>> part(crowd[0], wrapped_space<int, 2/*R*/, 9, 5>());
+			}
+			catch (const std::invalid_argument&) {
+				rejected = true;
+			}
+			assert(rejected);
+
+			// ranks as processes
+			typedef wrapped_space<int, 1/*R*/, 16, 6> G;
+			G space;
+			for (position_t pos = 0; pos < G::size(); ++pos)
+				space[pos] = (int)(pos % 5);
+			stencil_engine<G> reference(space, 1);
+			reference.step(6, rule);
+
+			socket_transport net = socket_transport::fork(3);
+			partitioned_grid<G> part(net, space);
+			part.step(6, rule);
+			G result(-1);
+			part.gather(result);
+			if (net.rank() != 0)
+				_exit(0);
+			assert(net.join() == 0);
+			assert(result == reference.state());
+		},
+#endif
+		[]() {
+			std::clog << "frame recorder test\n";
+			typedef wrapped_space<bool, 1/*R*/, 20, 30> space;
+			const std::string path = "hyperspace-frames-test.log";
+			auto life = [](bool alive, auto neighbors) {
+				int count = 0;
+				for (bool x : neighbors)
+					count += x;
+				return count == 3 or (alive and count == 2);
+			};
+
+			space initial(false);
+			initial(0, 1) = initial(1, 2) = initial(2, 0) = initial(2, 1) = initial(2, 2) = true;
+			initial(10, 11) = initial(10, 12) = initial(10, 13) = true; // blinker
+			std::vector<space> history;
+			{
+				frame_recorder<space> recorder(path, 16);
+				stencil_engine<space> engine(initial, 2);
+				for (int gen = 0; gen < 100; ++gen) {
+					history.push_back(engine.state());
+					recorder.record(engine.state());
+					engine.step(1, life);
+				}
+				assert(recorder.frames() == 100);
+			}
+
+			frame_reader<space> reader(path);
+			assert(reader.frames() == 100);
+			space g;
+			for (std::uint64_t gen : { 57, 3, 58, 59, 99, 0, 16, 15, 15 }) {
+				reader.read(gen, g);
+				assert(g == history[gen]);
+			}
+			for (std::uint64_t gen = 0; gen < reader.frames(); ++gen)
+				assert(reader.read(gen) == history[gen]);
+
+			std::FILE* log = std::fopen(path.c_str(), "rb");
+			std::fseek(log, 0, SEEK_END);
+			assert((position_t)std::ftell(log) < 100 * space::size() / 4);
+			std::fclose(log);
+			std::remove(path.c_str());
+
+			typedef unwrapped_space<int, 1/*R*/, 6, 7, 8> numbers;
+			numbers n(0);
+			{
+				frame_recorder<numbers> recorder(path, 3, 1);
+				for (int gen = 0; gen < 10; ++gen) {
+					n(gen % 6, 3, 4) += gen * 1000;
+					recorder.record(n);
+				}
+			}
+			frame_reader<numbers> numbers_reader(path);
+			assert(numbers_reader.read(9) == n);
+			assert(numbers_reader.read(4)(4, 3, 4) == 4000 and numbers_reader.read(4)(5, 3, 4) == 0);
+			std::remove(path.c_str());
+#ifdef __linux__
+			// a full disk is reported rather than dropping the frames
+			bool reported = false;
+			try {
+				frame_recorder<numbers> full("/dev/full", 3, 1);
+				for (int gen = 0; gen < 10; ++gen)
+					full.record(n);
+				full.close();
+			}
+			catch (const std::system_error& e) {
+				reported = e.code().value() == ENOSPC;
+			}
+			assert(reported);
+#endif
+		},
+		[]() {
+			std::clog << "aligned and arena allocation test\n";
+			aligned_grid<float, 1/*R*/, true, 10, 10> small(1.0f);
+			assert((std::uintptr_t)&small[0] % cache_line == 0);
+			aligned_grid<double, 1/*R*/, true, 600, 600> large(0.0); // over 2 MiB
+			assert((std::uintptr_t)&large[0] % huge_page == 0);
+
+			auto kernel = [](auto& next, const auto& g) {
+				for (auto it = g.begin(); it != g.end(); ++it) {
+					int sum = 0;
+					for (auto off : it)
+						sum += it[off];
+					next[it] = (*it + sum) % 11;
+				}
+			};
+			typedef unwrapped_space<int, 1/*R*/, 8, 9, 10> plain;
+			typedef arena_grid<int, 1/*R*/, false, 8, 9, 10> pooled;
+			arena memory(4 * pooled::size() * sizeof(int));
+
+			plain p(3), p_next;
+			pooled a(3, memory);
+			for (int job = 0; job < 100; ++job) {
+				pooled a_next(0, memory), copy(a);
+				assert((std::uintptr_t)&a_next[0] % cache_line == 0);
+				kernel(a_next, copy);
+				swap(a, a_next);
+				kernel(p_next, p);
+				swap(p, p_next);
+			}
+			// the released cells were reused
+			assert(memory.size() <= 3 * pooled::size() * sizeof(int) + 3 * cache_line);
+			for (position_t pos = 0; pos < plain::size(); ++pos)
+				assert(a[pos] == p[pos]);
+
+			bool exhausted = false;
+			try {
+				std::vector<pooled> many(4, pooled(0, memory));
+			}
+			catch (const std::bad_alloc&) {
+				exhausted = true;
+			}
+			assert(exhausted);
+		},
+		[]() {
+			std::clog << "first-touch initialization test\n";
+			typedef numa_grid<int, 1/*R*/, true, 13, 6, 5> numa;
+			typedef wrapped_space<int, 1/*R*/, 13, 6, 5> plain;
+			static_assert(std::is_same<numa::space_offsets, plain::space_offsets>::value);
+
+			// the slabs cover the grid in order, and those of packed booleans start at whole words
+			for (unsigned workers : { 1u, 4u, 13u, 20u }) {
+				position_t next = 0;
+				for (unsigned w = 0; w < workers; ++w) {
+					const auto cells = grid_slab<numa>(workers, w);
+					assert(cells.first == next and cells.first <= cells.second);
+					next = cells.second;
+					assert((grid_slab<unwrapped_space<bool, 1/*R*/, 9, 100>>(workers, w).first % 512 == 0));
+				}
+				assert(next == numa::size());
+			}
+
+			numa g;
+			parallel_fill(g, 7, 4);
+			for (position_t pos = 0; pos < numa::size(); ++pos)
+				assert(g[pos] == 7);
+			parallel_generate(g, []() {
+				static std::atomic<int> counter{ 0 };
+				return counter++;
+			}, 3, true);
+			bool thrown = false;
+			try {
+				parallel_generate(g, []() -> int { throw std::runtime_error("generator failed"); }, 3);
+			}
+			catch (const std::runtime_error&) {
+				thrown = true;
+			}
+			assert(thrown);
+			std::vector<bool> seen(numa::size());
+			for (position_t pos = 0; pos < numa::size(); ++pos)
+				seen[g[pos]] = true;
+			assert(std::count(seen.begin(), seen.end(), true) == (long)numa::size());
+
+			auto rule = [](int cell, const auto& neighbors) { return (cell + neighbors.sum()) % 17; };
+			plain p;
+			for (position_t pos = 0; pos < numa::size(); ++pos)
+				p[pos] = g[pos] = (int)(pos * 5 % 17);
+#ifdef __linux__
+			cpu_set_t before, after;
+			assert(::sched_getaffinity(0, sizeof(before), &before) == 0);
+#endif
+			stencil_engine<numa> local(g, 4, true);
+			stencil_engine<plain> reference(p, 1);
+			local.step(5, rule);
+			reference.step(5, rule);
+			for (position_t pos = 0; pos < numa::size(); ++pos)
+				assert(local.state()[pos] == reference.state()[pos]);
+#ifdef __linux__
+			// the calling thread is pinned only while it works for the engine
+			assert(::sched_getaffinity(0, sizeof(after), &after) == 0 and CPU_EQUAL(&before, &after));
+#endif
+
+			// the buffers of an engine share the allocator of the initial grid
+			typedef arena_grid<int, 1/*R*/, true, 8, 8> pooled;
+			arena memory(4 * pooled::size() * sizeof(int));
+			pooled a(3, memory);
+			stencil_engine<pooled> arena_engine(a, 2);
+			arena_engine.step(1, rule);
+			assert(arena_engine.state().storage().get_allocator() == a.storage().get_allocator());
+			assert(arena_engine.state()[0] == (3 + 8 * 3) % 17);
+		},
+		[]() {
+			std::clog << "structure-of-arrays grid test\n";
+			struct cell { int state; double energy; bool flag; };
+			typedef grid<cell, 1/*R*/, true, 7, 9> aos;
+			typedef soa_grid<std::tuple<int, double, bool>, 1/*R*/, true, 7, 9> soa;
+			static_assert(soa::size() == aos::size());
+
+			aos a;
+			soa s(std::make_tuple(0, 0.5, false));
+			assert(std::get<1>(s(2, 3)) == 0.5);
+			for (position_t pos = 0; pos < aos::size(); ++pos) {
+				a[pos] = cell{ int(pos * 7 % 5), 0.5 * pos, pos % 3 == 0 };
+				s[pos] = std::make_tuple(a[pos].state, a[pos].energy, a[pos].flag);
+			}
+			assert(s.field<0>().size() == soa::size() and s.field<1>()[10] == 5.0);
+
+			// a sweep reading the state field of the neighbors only
+			aos a_next;
+			soa s_next;
+			for (auto it = a.begin(); it != a.end(); ++it) {
+				int sum = 0;
+				for (auto off : it)
+					sum += it[off].state;
+				a_next[it] = cell{ sum % 5, it->energy + sum, sum % 2 == 0 };
+			}
+			for (auto it = s.begin(); it != s.end(); ++it) {
+				assert(it.size() == 8);
+				int sum = 0;
+				for (auto off : it)
+					sum += it.get<0>(off);
+				s_next[it] = std::make_tuple(sum % 5, it.get<1>() + sum, sum % 2 == 0);
+			}
+			for (position_t pos = 0; pos < aos::size(); ++pos) {
+				const auto c = s_next[pos];
+				assert(std::get<0>(c) == a_next[pos].state and std::get<1>(c) == a_next[pos].energy and std::get<2>(c) == a_next[pos].flag);
+			}
+
+			auto it = s_next.at(3, 4);
+			assert(it.coordinate(0) == 4 and it.coordinate(1) == 3); // innermost first
+			std::get<2>(*it) = not std::get<2>(*it);
+			soa copy(s_next);
+			assert(copy == s_next);
+			std::get<0>(copy(3, 4)) += 1;
+			assert(copy != s_next);
+			swap(copy, s_next);
+			assert(std::get<0>(s_next(3, 4)) == std::get<0>(copy(3, 4)) + 1);
+		},
+		[]() {
+			std::clog << "neighborhood policy test\n";
+			// compares the offsets of every cell with those found by displacing its coordinates
+			auto brute_force = [](auto g, auto contains) {
+				typedef decltype(g) G;
+				const offset_t R = G::space_offsets::radius, Y = G::dimension(1), X = G::dimension(0);
+				for (auto it = g.begin(); it != g.end(); ++it) {
+					std::vector<offset_t> expected;
+					for (offset_t dy = -R; dy <= R; ++dy)
+						for (offset_t dx = -R; dx <= R; ++dx) {
+							offset_t y = it.coordinate(1) + dy, x = it.coordinate(0) + dx;
+							if (G::space_offsets::wrapped) {
+								y = (y + Y) % Y;
+								x = (x + X) % X;
+							}
+							const offset_t off = y * X + x - (offset_t)(position_t)it;
+							if (y >= 0 and y < Y and x >= 0 and x < X and off != 0 and contains(dy, dx))
+								expected.push_back(off);
+						}
+					std::sort(expected.begin(), expected.end());
+					expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+					assert(it.neighbors_offsets() == expected);
+				}
+			};
+			auto l1 = [](offset_t R) { return [R](offset_t dy, offset_t dx) { return std::abs(dy) + std::abs(dx) <= R; }; };
+			auto moore_box = [](offset_t, offset_t) { return true; };
+			auto east_north = [](offset_t dy, offset_t dx) { return (dy == 0 and dx == 1) or (dy == -1 and dx == 0); };
+
+			brute_force(neighborhood_grid<int, von_neumann, 1, false, 6, 7>(), l1(1));
+			brute_force(neighborhood_grid<int, von_neumann, 1, true, 6, 7>(), l1(1));
+			brute_force(neighborhood_grid<int, von_neumann, 2, false, 6, 7>(), l1(2));
+			brute_force(neighborhood_grid<int, von_neumann, 2, true, 6, 7>(), l1(2));
+			brute_force(neighborhood_grid<int, von_neumann, 2, true, 3, 4>(), l1(2)); // smaller than the box
+			brute_force(neighborhood_grid<int, mask<0, 1, -1, 0>, 1, false, 5, 5>(), east_north);
+			brute_force(neighborhood_grid<int, mask<0, 1, -1, 0>, 1, true, 5, 5>(), east_north);
+			brute_force(neighborhood_grid<int, moore, 1, true, 2, 5>(), moore_box);
+
+			typedef neighborhood_grid<int, von_neumann, 1, false, 4, 5, 6> cross;
+			assert(cross::neighbors_offsets(0).size() == 6);
+			assert(cross::neighbors_offsets(0) == std::vector<offset_t>({ -30, -6, -1, 1, 6, 30 }));
+			assert(cross().begin().size() == 3); // corner
+
+			// sparse evaluation of an asymmetric neighborhood
+			typedef neighborhood_grid<int, mask<0, 1, -1, 0>, 1, true, 12, 16> drift;
+			auto rule = [](int cell, auto neighbors) {
+				int sum = 0;
+				for (int x : neighbors)
+					sum += x;
+				return sum > 0 ? (sum + cell) % 4 : cell / 2;
+			};
+			drift initial(0);
+			initial(3, 4) = 3;
+			initial(7, 9) = 2;
+			incremental_engine<drift> sparse(initial);
+			stencil_engine<drift> dense(initial, 2);
+			for (int s = 0; s < 20; ++s) {
+				sparse.step(1, rule);
+				dense.step(1, rule);
+				assert(sparse.state() == dense.state());
+			}
+		},
+		[]() {
+			std::clog << "weighted stencil test\n";
+			// 5-point Laplacian against the hand-written loop
+			typedef wrapped_space<double, 1/*R*/, 40, 50> field;
+			constexpr std::array<stencil_tap<double, 2>, 5> laplacian{ {
+				{ { -1, 0 }, 1.0 }, { { 0, -1 }, 1.0 }, { { 0, 0 }, -4.0 }, { { 0, 1 }, 1.0 }, { { 1, 0 }, 1.0 } } };
+			field u, lu, expected;
+			for (position_t pos = 0; pos < field::size(); ++pos)
+				u[pos] = std::sin(0.1 * pos) + 0.01 * (pos % 7);
+			field::apply_stencil(u, lu, laplacian);
+			for (int y = 0; y < 40; ++y)
+				for (int x = 0; x < 50; ++x)
+					expected(y, x) = u((y + 39) % 40, x) + u(y, (x + 49) % 50) - 4 * u(y, x) + u(y, (x + 1) % 50) + u((y + 1) % 40, x);
+			for (position_t pos = 0; pos < field::size(); ++pos)
+				assert(std::abs(lu[pos] - expected[pos]) < 1e-12);
+
+			// an asymmetric runtime kernel of radius 2 over an unwrapped 3D space, against the brute force
+			typedef unwrapped_space<int, 1/*R*/, 5, 6, 9> cube;
+			std::vector<stencil_tap<int, 3>> kernel = { { { 0, 0, 0 }, 3 }, { { 0, 0, 2 }, -1 }, { { -1, 1, 0 }, 2 }, { { 1, -2, -1 }, 5 } };
+			cube a, b;
+			for (position_t pos = 0; pos < cube::size(); ++pos)
+				a[pos] = int(pos * 37 % 11) - 5;
+			cube::apply_stencil(a, b, kernel);
+			for (int z = 0; z < 5; ++z)
+				for (int y = 0; y < 6; ++y)
+					for (int x = 0; x < 9; ++x) {
+						int sum = 0;
+						for (const auto& tap : kernel) {
+							const int zz = z + tap.delta[0], yy = y + tap.delta[1], xx = x + tap.delta[2];
+							if (zz >= 0 and zz < 5 and yy >= 0 and yy < 6 and xx >= 0 and xx < 9)
+								sum += tap.weight * a(zz, yy, xx);
+						}
+						assert(b(z, y, x) == sum);
+					}
+
+			// float weights over integer cells, a kernel wider than the space
+			typedef wrapped_space<int, 1/*R*/, 3> ring;
+			ring r, blurred;
+			r(0) = 10; r(1) = 20; r(2) = 30;
+			ring::apply_stencil(r, blurred, std::vector<stencil_tap<double, 1>>{ { { -4 }, 0.5 }, { { 0 }, 0.5 } });
+			assert(blurred(0) == 20 and blurred(1) == 15 and blurred(2) == 25);
+		},
+		[]() {
+			std::clog << "random-access iterators test\n";
+			typedef unwrapped_space<int, 1/*R*/, 6, 7, 8> space;
+			static_assert(std::is_same<std::iterator_traits<space::iterator>::iterator_category, std::random_access_iterator_tag>::value);
+			space g;
+			auto first = g.begin(), last = g.end();
+			assert(last - first == (offset_t)space::size());
+
+			// jumps agree with stepping, including the neighborhood type
+			auto walk = first;
+			for (offset_t n = 0; n < (offset_t)space::size(); ++n, ++walk) {
+				const auto jump = first + n;
+				assert(jump == walk and jump.type() == walk.type() and jump.coordinate(2) == walk.coordinate(2));
+				assert(jump.neighbors_offsets() == std::vector<offset_t>(walk.begin(), walk.end()));
+			}
+			assert(first + (offset_t)space::size() == last and last - (offset_t)space::size() == first);
+			auto it = first;
+			it += 100;
+			it -= 37;
+			assert(it - first == 63 and it[0] == *it and first < it and it <= it and last > it and 1 + it == it + 1);
+			assert(std::prev(last).coordinate(0) == 7 and std::distance(first, last) == (offset_t)space::size());
+
+			// standard algorithms that need random access
+			for (position_t pos = 0; pos < space::size(); ++pos)
+				g[pos] = int(pos * 7919 % 1009);
+			std::sort(g.begin(), g.end());
+			assert(std::is_sorted(g.begin(), g.end()));
+			const space& sorted = g;
+			space::const_iterator found = std::lower_bound(sorted.begin(), sorted.end(), 500);
+			assert(*found >= 500 and *std::prev(found) < 500);
+			space::const_iterator converted = g.begin() + 5;
+			assert(converted - sorted.begin() == 5);
+
+			// range splitting across threads
+			space next;
+			auto sweep = [&](space::const_iterator from, space::const_iterator to) {
+				for (; from != to; ++from)
+					next[from] = from.neighbors().sum();
+			};
+			const auto half = sorted.begin() + (sorted.end() - sorted.begin()) / 2;
+			std::thread other(sweep, half, sorted.end());
+			sweep(sorted.begin(), half);
+			other.join();
+			for (auto c = sorted.begin(); c != sorted.end(); ++c)
+				assert(next[c] == c.neighbors().sum());
+		},
+		[]() {
+			std::clog << "Morton layout test\n";
+			for (std::uint64_t x : { 0ULL, 1ULL, 5ULL, 0x1234ULL })
+				for (std::uint64_t mask : { 0x5555ULL, 0x924924ULL, 0xf0f0ULL })
+					assert(detail::extract(detail::deposit(x, mask), mask) == (x & ((1ULL << std::bitset<64>(mask).count()) - 1)));
+
+			// a neighbor sweep in Morton order agrees with the row-major grid
+			auto crosscheck = [](auto row_major, auto morton, auto at) {
+				typedef decltype(row_major) G;
+				typedef decltype(morton) M;
+				static_assert(M::size() == G::size());
+				for (auto it = row_major.begin(); it != row_major.end(); ++it)
+					*it = int((position_t)it * 7919 % 13);
+				for (auto it = row_major.begin(); it != row_major.end(); ++it)
+					at(morton, it) = *it;
+
+				G next_row;
+				M next_morton;
+				for (auto it = row_major.begin(); it != row_major.end(); ++it)
+					next_row[it] = it.neighbors().sum() * 3 + *it + (int)it.size();
+				position_t visited = 0;
+				for (auto it = morton.begin(); it != morton.end(); ++it, ++visited)
+					next_morton[it] = it.neighbors().sum() * 3 + *it + (int)it.size();
+				assert(visited == G::size());
+				for (auto it = next_row.begin(); it != next_row.end(); ++it)
+					assert(at(next_morton, it) == *it);
+			};
+			auto at2 = [](auto& m, const auto& it) -> int& { return m(it.coordinate(1), it.coordinate(0)); };
+			auto at3 = [](auto& m, const auto& it) -> int& { return m(it.coordinate(2), it.coordinate(1), it.coordinate(0)); };
+			auto at4 = [](auto& m, const auto& it) -> int& { return m(it.coordinate(3), it.coordinate(2), it.coordinate(1), it.coordinate(0)); };
+			crosscheck(wrapped_space<int, 1/*R*/, 8, 16>(), morton_grid<int, 1, true, 8, 16>(), at2);
+			crosscheck(unwrapped_space<int, 1/*R*/, 5, 6, 7>(), morton_grid<int, 1, false, 5, 6, 7>(), at3);
+			crosscheck(wrapped_space<int, 2/*R*/, 3, 6, 7>(), morton_grid<int, 2, true, 3, 6, 7>(), at3);
+			crosscheck(wrapped_space<int, 1/*R*/, 4, 5, 4, 6>(), morton_grid<int, 1, true, 4, 5, 4, 6>(), at4);
+
+			// interleaved bits, innermost dimension lowest
+			typedef morton_grid<char, 1, false, 4, 4> z;
+			assert(z::storage_size() == 16 and z::index(0, 1) == 1 and z::index(1, 0) == 2 and z::index(3, 3) == 15);
+			const z zz('a');
+			auto corner = zz.at(0, 0);
+			assert(corner.size() == 3 and corner.coordinate(0) == 0);
+			assert(zz.at(2, 1).neighbors().count_if([](char c) { return c == 'a'; }) == 8);
+
+			// the view owns the offsets, so it outlives the iterator it came from
+			const morton_grid<int, 1, false, 8, 8> ones(1);
+			int around = 0;
+			for (int x : ones.at(0, 0).neighbors())
+				around += x;
+			assert(around == 3);
+		},
+		[]() {
+			std::clog << "tiled layout test\n";
+			// a neighbor sweep over the tiles agrees with the row-major grid
+			auto crosscheck = [](auto row_major, auto tiled, auto at) {
+				typedef decltype(row_major) G;
+				typedef decltype(tiled) L;
+				for (auto it = row_major.begin(); it != row_major.end(); ++it)
+					*it = int((position_t)it * 7919 % 13);
+				for (auto it = row_major.begin(); it != row_major.end(); ++it)
+					at(tiled, it) = *it;
+
+				G next_row;
+				L next_tiled;
+				for (auto it = row_major.begin(); it != row_major.end(); ++it)
+					next_row[it] = it.neighbors().sum() * 3 + *it + (int)it.size();
+				position_t visited = 0;
+				for (position_t t = 0; t < L::tiles(); ++t)
+					for (auto it = tiled.tile_begin(t); it != tiled.tile_end(t); ++it, ++visited) {
+						assert((position_t)it / L::tile_cells == t);
+						next_tiled[it] = it.neighbors().sum() * 3 + *it + (int)it.size();
+					}
+				assert(visited == G::size());
+				for (auto it = next_row.begin(); it != next_row.end(); ++it)
+					assert(at(next_tiled, it) == *it);
+			};
+			auto at2 = [](auto& m, const auto& it) -> int& { return m(it.coordinate(1), it.coordinate(0)); };
+			auto at3 = [](auto& m, const auto& it) -> int& { return m(it.coordinate(2), it.coordinate(1), it.coordinate(0)); };
+			crosscheck(wrapped_space<int, 1/*R*/, 16, 16>(), tiled_grid<int, 8, 1, true, 16, 16>(), at2);
+			crosscheck(unwrapped_space<int, 1/*R*/, 10, 13, 9>(), tiled_grid<int, 4, 1, false, 10, 13, 9>(), at3);
+			crosscheck(wrapped_space<int, 1/*R*/, 10, 13, 9>(), tiled_grid<int, 4, 1, true, 10, 13, 9>(), at3);
+			crosscheck(wrapped_space<int, 2/*R*/, 3, 11, 12>(), tiled_grid<int, 5, 2, true, 3, 11, 12>(), at3);
+			crosscheck(unwrapped_space<int, 2/*R*/, 5, 7, 9>(), tiled_grid<int, 3, 2, false, 5, 7, 9>(), at3);
+			crosscheck(wrapped_space<int, 2/*R*/, 4, 7, 9>(), tiled_grid<int, 2, 2, true, 4, 7, 9>(), at3);
+
+			typedef tiled_grid<int, 8, 1, false, 20, 20, 20> bricks;
+			static_assert(bricks::tiles() == 27 and bricks::storage_size() == 27 * 512);
+			assert(bricks::index(0, 0, 1) == 1 and bricks::index(0, 1, 0) == 8 and bricks::index(1, 0, 0) == 64 and bricks::index(0, 0, 8) == 512);
+			const bricks b(1);
+			const auto interior = b.at(3, 3, 3).neighbors_offsets();
+			assert(std::equal(interior.begin(), interior.end(), bricks::tile_interior.begin(), bricks::tile_interior.end()));
+			assert(b.at(3, 3, 3).neighbors().sum() == 26 and b.at(3, 3, 7).neighbors().sum() == 26 and b.at(19, 0, 0).size() == 7);
+
+			// cells of the same position classes have the same offsets
+			const auto face = b.at(3, 3, 7).neighbors_offsets(), same = b.at(11, 3, 7).neighbors_offsets();
+			assert(std::equal(face.begin(), face.end(), same.begin(), same.end()) and face.size() == 26);
+			const tiled_grid<int, 4, 1, false, 8, 8> small(1);
+			int around = 0;
+			for (int x : small.at(0, 0).neighbors())
+				around += x;
+			assert(around == 3);
+		},
+		[]() {
+			std::clog << "ISSUE #1: auto-deduced type of the neighboring cells test\n";
+			hyper::unwrapped_space<int, 1/*R*/, 5> spc{ 0 };
+			auto cell = spc.at(2);
+
+			for (auto& x : cell.neighbors())
+				x = 42;
+			assert(spc[1] == 42 and spc[2] == 0 and spc[3] == 42);
+
+			// fused reductions
+			spc[1] = 5;
+			assert(cell.neighbors().sum() == 47);
+			assert(cell.neighbors().count_if([](int x) { return x > 10; }) == 1);
+			const auto& constant = spc;
+			assert(constant.at(0).neighbors().sum() == 5 and constant.at(0).neighbors().size() == 1);
+
+			hyper::wrapped_space<bool, 1/*R*/, 4, 4> life(false);
+			life(0, 1) = life(1, 0) = life(3, 3) = true;
+			const auto& cells = life;
+			assert(cells.at(0, 0).neighbors().sum() == 3);
+			for (auto x : life.at(2, 2).neighbors()) // proxies of vector<bool>
+				x = true;
+			assert(cells.at(2, 2).neighbors().count_if([](bool alive) { return alive; }) == 8);
+		},
+		[]() {
+			std::clog << "ISSUE #2: range-for over the neighbors of boolean cells test\n";
+			hyper::unwrapped_space<bool, 1/*R*/, 5> spc(false);
+			auto cell = spc.at(2);
+
+			for (auto&& x : cell.neighbors()) // vector<bool> yields proxies, not bool&
+				x = true;
+			assert(spc[1] and not spc[2] and spc[3] and not spc[0]);
+			int alive = 0;
+			for (bool x : cell.neighbors())
+				alive += x;
+			assert(alive == 2);
 		}
 		}; // namespace sprogar
 